@@ -216,54 +216,69 @@ void htif_t::clear_chunk(addr_t taddr, size_t len)
     write_chunk(taddr + pos, std::min(len - pos, chunk_max_size()), zeros);
 }
 
-int htif_t::run()
+bool htif_t::exit_requested()
 {
-  start();
+  return signal_exit || exitcode != 0;
+}
 
-  auto enq_func = [](std::queue<reg_t>* q, uint64_t x) { q->push(x); };
-  std::queue<reg_t> fromhost_queue;
-  std::function<void(reg_t)> fromhost_callback =
-    std::bind(enq_func, &fromhost_queue, std::placeholders::_1);
+bool htif_t::handle_tohost()
+{
+  uint64_t tohost = 0;
 
-  if (tohost_addr == 0) {
-    while (true)
-      idle();
+  try {
+    if (tohost_may_be_pending() &&
+        (tohost = from_target(mem.read_uint64(tohost_addr))) != 0)
+      mem.write_uint64(tohost_addr, target_endian<uint64_t>::zero);
+  } catch (mem_trap_t& t) {
+    bad_address("accessing tohost", t.get_tval());
   }
 
-  while (!signal_exit && exitcode == 0)
-  {
-    uint64_t tohost;
+  if (tohost == 0)
+    return false;
 
-    try {
-      if ((tohost = from_target(mem.read_uint64(tohost_addr))) != 0)
-        mem.write_uint64(tohost_addr, target_endian<uint64_t>::zero);
-    } catch (mem_trap_t& t) {
-      bad_address("accessing tohost", t.get_tval());
-    }
+  try {
+    command_t cmd(mem, tohost, [this](uint64_t x) { fromhost_queue.push(x); });
+    device_list.handle_command(cmd);
+  } catch (mem_trap_t& t) {
+    std::stringstream tohost_hex;
+    tohost_hex << std::hex << tohost;
+    bad_address("host was accessing memory on behalf of target (tohost = 0x" + tohost_hex.str() + ")", t.get_tval());
+  }
+  return true;
+}
 
-    try {
-      if (tohost != 0) {
-        command_t cmd(mem, tohost, fromhost_callback);
-        device_list.handle_command(cmd);
-      } else {
-        idle();
-      }
+void htif_t::tick_devices()
+{
+  try {
+    device_list.tick();
+  } catch (mem_trap_t& t) {
+    bad_address("host was accessing memory on behalf of target", t.get_tval());
+  }
 
-      device_list.tick();
-    } catch (mem_trap_t& t) {
-      std::stringstream tohost_hex;
-      tohost_hex << std::hex << tohost;
-      bad_address("host was accessing memory on behalf of target (tohost = 0x" + tohost_hex.str() + ")", t.get_tval());
+  try {
+    if (!fromhost_queue.empty() && !mem.read_uint64(fromhost_addr)) {
+      mem.write_uint64(fromhost_addr, to_target(fromhost_queue.front()));
+      fromhost_queue.pop();
     }
+  } catch (mem_trap_t& t) {
+    bad_address("accessing fromhost", t.get_tval());
+  }
+}
 
-    try {
-      if (!fromhost_queue.empty() && !mem.read_uint64(fromhost_addr)) {
-        mem.write_uint64(fromhost_addr, to_target(fromhost_queue.front()));
-        fromhost_queue.pop();
-      }
-    } catch (mem_trap_t& t) {
-      bad_address("accessing fromhost", t.get_tval());
-    }
+int htif_t::run()
+{
+  start();
+
+  if (tohost_addr == 0) {
+    while (!exit_requested())
+      idle();
+  }
+
+  while (!exit_requested())
+  {
+    if (!handle_tohost())
+      idle();
+    tick_devices();
   }
 
   stop();
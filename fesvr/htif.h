@@ -10,6 +10,7 @@
 #include <string.h>
 #include <map>
 #include <vector>
+#include <queue>
 #include <assert.h>
 
 class htif_t : public chunked_memif_t
@@ -68,8 +69,25 @@ class htif_t : public chunked_memif_t
   virtual void idle() {}
 
   const std::vector<std::string>& host_args() { return hargs; }
+  const std::vector<std::string>& target_args() { return targs; }
 
   reg_t get_entry_point() { return entry; }
+  addr_t get_tohost_addr() { return tohost_addr; }
+  void set_exit_code(int code) { exitcode = code << 1 | 1; }
+
+  // indicates whether the target may have written tohost since the last
+  // call; returning false lets run() skip reading it
+  virtual bool tohost_may_be_pending() { return true; }
+
+  // The steps of run()'s service loop, for hosts that drive the target
+  // themselves and service it between quanta: handle_tohost() dispatches a
+  // pending tohost command, returning false if there was none; tick_devices()
+  // ticks the host devices and delivers any queued fromhost value; and
+  // exit_requested() reports whether the target has exited or the host
+  // was signalled to stop.
+  bool handle_tohost();
+  void tick_devices();
+  bool exit_requested();
 
   // indicates that the initial program load can skip writing this address
   // range to memory, because it has already been loaded through a sideband
@@ -102,8 +120,7 @@ class htif_t : public chunked_memif_t
   bcd_t bcd;
   std::vector<device_t*> dynamic_devices;
   std::vector<std::string> payloads;
-
-  const std::vector<std::string>& target_args() { return targs; }
+  std::queue<reg_t> fromhost_queue;
 
   std::map<uint64_t, std::string> addr2symbol;
 
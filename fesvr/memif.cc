@@ -39,6 +39,26 @@ void memif_t::read(addr_t addr, size_t len, void* bytes)
     cmemif->read_chunk(addr + pos, std::min(cmemif->chunk_max_size(), len - pos), (char*)bytes + pos);
 }
 
+bool memif_t::host_iov(addr_t addr, size_t len, std::vector<struct iovec>* iov)
+{
+  size_t max_chunk = cmemif->chunk_max_size();
+  iov->clear();
+
+  for (size_t pos = 0, n; pos < len; pos += n) {
+    n = std::min(len - pos, max_chunk - size_t((addr + pos) % max_chunk));
+    char* p = (char*)cmemif->chunk_host_ptr(addr + pos, n);
+    if (!p)
+      return false;
+
+    if (!iov->empty() && (char*)iov->back().iov_base + iov->back().iov_len == p)
+      iov->back().iov_len += n;
+    else
+      iov->push_back({p, n});
+  }
+
+  return true;
+}
+
 void memif_t::write(addr_t addr, size_t len, const void* bytes)
 {
   size_t align = cmemif->chunk_align();
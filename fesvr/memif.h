@@ -5,6 +5,8 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/uio.h>
+#include <vector>
 #include "byteorder.h"
 
 typedef uint64_t reg_t;
@@ -27,6 +29,10 @@ public:
   virtual size_t chunk_align() = 0;
   virtual size_t chunk_max_size() = 0;
 
+  // return a host pointer through which [taddr, taddr + len) can be accessed
+  // directly, or NULL if it must go through read_chunk/write_chunk
+  virtual void* chunk_host_ptr(addr_t taddr, size_t len) { return NULL; }
+
   virtual void set_target_endianness(memif_endianness_t endianness) {}
   virtual memif_endianness_t get_target_endianness() const {
     return memif_endianness_undecided;
@@ -43,6 +49,10 @@ public:
   virtual void read(addr_t addr, size_t len, void* bytes);
   virtual void write(addr_t addr, size_t len, const void* bytes);
 
+  // describe [addr, addr + len) as host buffers that can be accessed in
+  // place; returns false if any part of it is not directly accessible
+  virtual bool host_iov(addr_t addr, size_t len, std::vector<struct iovec>* iov);
+
   // read and write 8-bit words
   virtual target_endian<uint8_t> read_uint8(addr_t addr);
   virtual target_endian<int8_t> read_int8(addr_t addr);
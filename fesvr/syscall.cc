@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <limits.h>
 #include <errno.h>
 #include <stdlib.h>
@@ -219,6 +220,10 @@ static reg_t sysret_errno(sreg_t ret)
 
 reg_t syscall_t::sys_read(reg_t fd, reg_t pbuf, reg_t len, reg_t a3, reg_t a4, reg_t a5, reg_t a6)
 {
+  std::vector<struct iovec> iov;
+  if (memif->host_iov(pbuf, len, &iov) && iov.size() <= IOV_MAX)
+    return sysret_errno(readv(fds.lookup(fd), iov.data(), iov.size()));
+
   std::vector<char> buf(len);
   ssize_t ret = read(fds.lookup(fd), buf.data(), len);
   reg_t ret_errno = sysret_errno(ret);
@@ -229,6 +234,10 @@ reg_t syscall_t::sys_read(reg_t fd, reg_t pbuf, reg_t len, reg_t a3, reg_t a4, r
 
 reg_t syscall_t::sys_pread(reg_t fd, reg_t pbuf, reg_t len, reg_t off, reg_t a4, reg_t a5, reg_t a6)
 {
+  std::vector<struct iovec> iov;
+  if (memif->host_iov(pbuf, len, &iov) && iov.size() == 1)
+    return sysret_errno(pread(fds.lookup(fd), iov[0].iov_base, len, off));
+
   std::vector<char> buf(len);
   ssize_t ret = pread(fds.lookup(fd), buf.data(), len, off);
   reg_t ret_errno = sysret_errno(ret);
@@ -239,6 +248,10 @@ reg_t syscall_t::sys_pread(reg_t fd, reg_t pbuf, reg_t len, reg_t off, reg_t a4,
 
 reg_t syscall_t::sys_write(reg_t fd, reg_t pbuf, reg_t len, reg_t a3, reg_t a4, reg_t a5, reg_t a6)
 {
+  std::vector<struct iovec> iov;
+  if (memif->host_iov(pbuf, len, &iov) && iov.size() <= IOV_MAX)
+    return sysret_errno(writev(fds.lookup(fd), iov.data(), iov.size()));
+
   std::vector<char> buf(len);
   memif->read(pbuf, len, buf.data());
   reg_t ret = sysret_errno(write(fds.lookup(fd), buf.data(), len));
@@ -247,6 +260,10 @@ reg_t syscall_t::sys_write(reg_t fd, reg_t pbuf, reg_t len, reg_t a3, reg_t a4,
 
 reg_t syscall_t::sys_pwrite(reg_t fd, reg_t pbuf, reg_t len, reg_t off, reg_t a4, reg_t a5, reg_t a6)
 {
+  std::vector<struct iovec> iov;
+  if (memif->host_iov(pbuf, len, &iov) && iov.size() == 1)
+    return sysret_errno(pwrite(fds.lookup(fd), iov[0].iov_base, len, off));
+
   std::vector<char> buf(len);
   memif->read(pbuf, len, buf.data());
   reg_t ret = sysret_errno(pwrite(fds.lookup(fd), buf.data(), len, off));
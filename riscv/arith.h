@@ -145,13 +145,7 @@ static inline uint64_t make_mask64(int pos, int len)
 
 static inline int popcount(uint64_t val)
 {
-  val = (val & 0x5555555555555555U) + ((val >>  1) & 0x5555555555555555U);
-  val = (val & 0x3333333333333333U) + ((val >>  2) & 0x3333333333333333U);
-  val = (val & 0x0f0f0f0f0f0f0f0fU) + ((val >>  4) & 0x0f0f0f0f0f0f0f0fU);
-  val = (val & 0x00ff00ff00ff00ffU) + ((val >>  8) & 0x00ff00ff00ff00ffU);
-  val = (val & 0x0000ffff0000ffffU) + ((val >> 16) & 0x0000ffff0000ffffU);
-  val = (val & 0x00000000ffffffffU) + ((val >> 32) & 0x00000000ffffffffU);
-  return val;
+  return __builtin_popcountll(val);
 }
 
 static inline int ctz(uint64_t val)
@@ -159,16 +153,7 @@ static inline int ctz(uint64_t val)
   if (!val)
     return 0;
 
-  int res = 0;
-
-  if ((val << 32) == 0) res += 32, val >>= 32;
-  if ((val << 48) == 0) res += 16, val >>= 16;
-  if ((val << 56) == 0) res += 8, val >>= 8;
-  if ((val << 60) == 0) res += 4, val >>= 4;
-  if ((val << 62) == 0) res += 2, val >>= 2;
-  if ((val << 63) == 0) res += 1, val >>= 1;
-
-  return res;
+  return __builtin_ctzll(val);
 }
 
 static inline int clz(uint64_t val)
@@ -176,16 +161,7 @@ static inline int clz(uint64_t val)
   if (!val)
     return 0;
 
-  int res = 0;
-
-  if ((val >> 32) == 0) res += 32, val <<= 32;
-  if ((val >> 48) == 0) res += 16, val <<= 16;
-  if ((val >> 56) == 0) res += 8, val <<= 8;
-  if ((val >> 60) == 0) res += 4, val <<= 4;
-  if ((val >> 62) == 0) res += 2, val <<= 2;
-  if ((val >> 63) == 0) res += 1, val <<= 1;
-
-  return res;
+  return __builtin_clzll(val);
 }
 
 static inline int log2(uint64_t val)
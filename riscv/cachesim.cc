@@ -2,12 +2,14 @@
 
 #include "cachesim.h"
 #include "common.h"
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <iomanip>
 
-cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char* _name)
-: sets(_sets), ways(_ways), linesz(_linesz), name(_name), log(false)
+cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char* _name,
+                         replacement_policy_t _policy)
+: sets(_sets), ways(_ways), linesz(_linesz), policy(_policy), name(_name), log(false)
 {
   init();
 }
@@ -15,12 +17,30 @@ cache_sim_t::cache_sim_t(size_t _sets, size_t _ways, size_t _linesz, const char*
 static void help()
 {
   std::cerr << "Cache configurations must be of the form" << std::endl;
-  std::cerr << "  sets:ways:blocksize" << std::endl;
+  std::cerr << "  sets:ways:blocksize[:policy]" << std::endl;
   std::cerr << "where sets, ways, and blocksize are positive integers, with" << std::endl;
-  std::cerr << "sets and blocksize both powers of two and blocksize at least 8." << std::endl;
+  std::cerr << "sets and blocksize both powers of two and blocksize at least 8," << std::endl;
+  std::cerr << "and policy is one of random (the default), lru, plru, srrip, or" << std::endl;
+  std::cerr << "fifo. plru requires ways to be a power of two no greater than 32." << std::endl;
   exit(1);
 }
 
+static replacement_policy_t parse_policy(const std::string& s)
+{
+  if (s == "random")
+    return REPL_RANDOM;
+  if (s == "lru")
+    return REPL_LRU;
+  if (s == "plru")
+    return REPL_PLRU;
+  if (s == "srrip")
+    return REPL_SRRIP;
+  if (s == "fifo")
+    return REPL_FIFO;
+  help();
+  return REPL_RANDOM;
+}
+
 cache_sim_t* cache_sim_t::construct(const char* config, const char* name)
 {
   const char* wp = strchr(config, ':');
@@ -28,13 +48,18 @@ cache_sim_t* cache_sim_t::construct(const char* config, const char* name)
   const char* bp = strchr(wp, ':');
   if (!bp++) help();
 
+  const char* pp = strchr(bp, ':');
+
   size_t sets = atoi(std::string(config, wp).c_str());
   size_t ways = atoi(std::string(wp, bp).c_str());
-  size_t linesz = atoi(bp);
+  size_t linesz = atoi(pp ? std::string(bp, pp).c_str() : bp);
+  replacement_policy_t policy = pp ? parse_policy(pp + 1) : REPL_RANDOM;
 
-  if (ways > 4 /* empirical */ && sets == 1)
-    return new fa_cache_sim_t(ways, linesz, name);
-  return new cache_sim_t(sets, ways, linesz, name);
+  // The tree and RRIP policies are modelled per set, like real hardware.
+  if (ways > 4 /* empirical */ && sets == 1 &&
+      (policy == REPL_RANDOM || policy == REPL_LRU || policy == REPL_FIFO))
+    return new fa_cache_sim_t(ways, linesz, name, policy);
+  return new cache_sim_t(sets, ways, linesz, name, policy);
 }
 
 void cache_sim_t::init()
@@ -43,12 +68,19 @@ void cache_sim_t::init()
     help();
   if(linesz < 8 || (linesz & (linesz-1)))
     help();
+  if(ways == 0)
+    help();
+  if(policy == REPL_PLRU && (ways > 32 || (ways & (ways-1))))
+    help();
 
   idx_shift = 0;
   for (size_t x = linesz; x>1; x >>= 1)
     idx_shift++;
 
   tags = new uint64_t[sets*ways]();
+  line_state.assign(sets*ways, 0);
+  set_state.assign(sets, 0);
+  lru_clock = 0;
   read_accesses = 0;
   read_misses = 0;
   bytes_read = 0;
@@ -56,13 +88,20 @@ void cache_sim_t::init()
   write_misses = 0;
   bytes_written = 0;
   writebacks = 0;
+  coherence_misses = 0;
+  coherence_invalidations = 0;
 
   miss_handler = NULL;
+  directory = NULL;
+  directory_id = 0;
 }
 
 cache_sim_t::cache_sim_t(const cache_sim_t& rhs)
  : sets(rhs.sets), ways(rhs.ways), linesz(rhs.linesz),
-   idx_shift(rhs.idx_shift), name(rhs.name), log(false)
+   idx_shift(rhs.idx_shift), policy(rhs.policy),
+   line_state(rhs.line_state), set_state(rhs.set_state),
+   lru_clock(rhs.lru_clock), name(rhs.name), log(false), directory(NULL),
+   directory_id(0), coherence_misses(0), coherence_invalidations(0)
 {
   tags = new uint64_t[sets*ways];
   memcpy(tags, rhs.tags, sets*ways*sizeof(uint64_t));
@@ -98,26 +137,146 @@ void cache_sim_t::print_stats()
   std::cout << "Writebacks:            " << writebacks << std::endl;
   std::cout << name << " ";
   std::cout << "Miss Rate:             " << mr << '%' << std::endl;
+  if (directory) {
+    std::cout << name << " ";
+    std::cout << "Coherence Misses:      " << coherence_misses << std::endl;
+    std::cout << name << " ";
+    std::cout << "Invalidations:         " << coherence_invalidations << std::endl;
+  }
+}
+
+void cache_sim_t::set_directory(coherence_directory_t* dir)
+{
+  if (dir->attach(this, &directory_id))
+    directory = dir;
+}
+
+void cache_sim_t::coherence_invalidate(uint64_t addr)
+{
+  uint64_t* line = check_tag(addr);
+  if (line) {
+    invalidate(line);
+    coherence_invalidations++;
+    invalidated_lines.insert(addr >> idx_shift);
+  }
+}
+
+void cache_sim_t::coherence_downgrade(uint64_t addr)
+{
+  uint64_t* line = check_tag(addr);
+  if (line && (*line & DIRTY)) {
+    *line &= ~DIRTY;
+    writebacks++;
+    if (miss_handler)
+      miss_handler->access(addr, linesz, true);
+  }
 }
 
 uint64_t* cache_sim_t::check_tag(uint64_t addr)
 {
   size_t idx = (addr >> idx_shift) & (sets-1);
   size_t tag = (addr >> idx_shift) | VALID;
+  uint64_t* set = &tags[idx*ways];
+
+  if (ways <= 64) {
+    // Compare every way without branching, so the loop vectorizes.
+    uint64_t hits = 0;
+    for (size_t i = 0; i < ways; i++)
+      hits |= uint64_t((set[i] & ~DIRTY) == tag) << i;
+    return hits ? &set[__builtin_ctzll(hits)] : NULL;
+  }
 
   for (size_t i = 0; i < ways; i++)
-    if (tag == (tags[idx*ways + i] & ~DIRTY))
-      return &tags[idx*ways + i];
+    if (tag == (set[i] & ~DIRTY))
+      return &set[i];
 
   return NULL;
 }
 
+void cache_sim_t::plru_touch(size_t idx, size_t way)
+{
+  // Node n's children are 2n and 2n+1; a set bit points the next victim
+  // at the right subtree, so point each node on the path away from way.
+  uint64_t& bits = set_state[idx];
+  size_t node = 1;
+  for (size_t half = ways / 2; half > 0; half /= 2) {
+    bool right = way & half;
+    if (right)
+      bits &= ~(uint64_t(1) << node);
+    else
+      bits |= uint64_t(1) << node;
+    node = 2 * node + right;
+  }
+}
+
+void cache_sim_t::touch(uint64_t* line)
+{
+  size_t pos = line - tags;
+  switch (policy) {
+    case REPL_LRU: line_state[pos] = ++lru_clock; break;
+    case REPL_PLRU: plru_touch(pos / ways, pos % ways); break;
+    case REPL_SRRIP: line_state[pos] = 0; break;
+    case REPL_RANDOM:
+    case REPL_FIFO: break;
+  }
+}
+
+size_t cache_sim_t::pick_victim(size_t idx)
+{
+  if (policy == REPL_RANDOM)
+    return lfsr.next() % ways;
+
+  uint64_t* set = &tags[idx*ways];
+  for (size_t i = 0; i < ways; i++)
+    if (!(set[i] & VALID))
+      return i;
+
+  uint64_t* state = &line_state[idx*ways];
+  switch (policy) {
+    case REPL_LRU:
+      return std::min_element(state, state + ways) - state;
+    case REPL_PLRU: {
+      size_t node = 1, way = 0;
+      for (size_t half = ways / 2; half > 0; half /= 2) {
+        bool right = (set_state[idx] >> node) & 1;
+        way |= right ? half : 0;
+        node = 2 * node + right;
+      }
+      return way;
+    }
+    case REPL_SRRIP:
+      while (true) {
+        for (size_t i = 0; i < ways; i++)
+          if (state[i] == 3)
+            return i;
+        for (size_t i = 0; i < ways; i++)
+          state[i]++;
+      }
+    case REPL_FIFO:
+      return set_state[idx]++ % ways;
+    default:
+      abort();
+  }
+}
+
+void cache_sim_t::fill(size_t idx, size_t way)
+{
+  switch (policy) {
+    case REPL_LRU: line_state[idx*ways + way] = ++lru_clock; break;
+    case REPL_PLRU: plru_touch(idx, way); break;
+    case REPL_SRRIP: line_state[idx*ways + way] = 2; break;
+    case REPL_RANDOM:
+    case REPL_FIFO: break;
+  }
+}
+
 uint64_t cache_sim_t::victimize(uint64_t addr)
 {
   size_t idx = (addr >> idx_shift) & (sets-1);
-  size_t way = lfsr.next() % ways;
+  size_t way = pick_victim(idx);
   uint64_t victim = tags[idx*ways + way];
   tags[idx*ways + way] = (addr >> idx_shift) | VALID;
+  fill(idx, way);
   return victim;
 }
 
@@ -126,15 +285,23 @@ void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
   store ? write_accesses++ : read_accesses++;
   (store ? bytes_written : bytes_read) += bytes;
 
+  uint64_t line_addr = addr & ~(linesz-1);
   uint64_t* hit_way = check_tag(addr);
   if (likely(hit_way != NULL))
   {
-    if (store)
+    if (store) {
+      // A dirty line is already held exclusively.
+      if (directory && !(*hit_way & DIRTY))
+        directory->write(line_addr, directory_id);
       *hit_way |= DIRTY;
+    }
+    touch(hit_way);
     return;
   }
 
   store ? write_misses++ : read_misses++;
+  if (directory && invalidated_lines.erase(addr >> idx_shift))
+    coherence_misses++;
   if (log)
   {
     std::cerr << name << " "
@@ -144,6 +311,10 @@ void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
 
   uint64_t victim = victimize(addr);
 
+  // The invalidated line would have been evicted by now anyway.
+  if (directory && !(victim & VALID))
+    invalidated_lines.erase(victim & ~DIRTY);
+
   if ((victim & (VALID | DIRTY)) == (VALID | DIRTY))
   {
     uint64_t dirty_addr = (victim & ~(VALID | DIRTY)) << idx_shift;
@@ -152,8 +323,14 @@ void cache_sim_t::access(uint64_t addr, size_t bytes, bool store)
     writebacks++;
   }
 
+  if (directory && (victim & VALID))
+    directory->evict((victim & ~(VALID | DIRTY)) << idx_shift, directory_id);
+
   if (miss_handler)
-    miss_handler->access(addr & ~(linesz-1), linesz, false);
+    miss_handler->access(line_addr, linesz, false);
+
+  if (directory)
+    store ? directory->write(line_addr, directory_id) : directory->read_miss(line_addr, directory_id);
 
   if (store)
     *check_tag(addr) |= DIRTY;
@@ -176,7 +353,7 @@ void cache_sim_t::clean_invalidate(uint64_t addr, size_t bytes, bool clean, bool
       }
 
       if (inval)
-        *hit_way &= ~VALID;
+        invalidate(hit_way);
     }
     cur_addr += linesz;
   }
@@ -184,27 +361,123 @@ void cache_sim_t::clean_invalidate(uint64_t addr, size_t bytes, bool clean, bool
     miss_handler->clean_invalidate(addr, bytes, clean, inval);
 }
 
-fa_cache_sim_t::fa_cache_sim_t(size_t ways, size_t linesz, const char* name)
-  : cache_sim_t(1, ways, linesz, name)
+fa_cache_sim_t::fa_cache_sim_t(size_t ways, size_t linesz, const char* name,
+                               replacement_policy_t policy)
+  : cache_sim_t(1, ways, linesz, name, policy),
+    prev(ways), next(ways), head(ways), tail(ways), used(0)
 {
+  index.reserve(ways);
+}
+
+void fa_cache_sim_t::unlink(size_t slot)
+{
+  (prev[slot] == ways ? head : next[prev[slot]]) = next[slot];
+  (next[slot] == ways ? tail : prev[next[slot]]) = prev[slot];
+}
+
+void fa_cache_sim_t::push_front(size_t slot)
+{
+  prev[slot] = ways;
+  next[slot] = head;
+  (head == ways ? tail : prev[head]) = slot;
+  head = slot;
 }
 
 uint64_t* fa_cache_sim_t::check_tag(uint64_t addr)
 {
-  auto it = tags.find(addr >> idx_shift);
-  return it == tags.end() ? NULL : &it->second;
+  auto it = index.find(addr >> idx_shift);
+  if (it == index.end() || !(tags[it->second] & VALID))
+    return NULL;
+  return &tags[it->second];
+}
+
+void fa_cache_sim_t::invalidate(uint64_t* line)
+{
+  size_t slot = line - tags;
+  index.erase(*line & ~(VALID | DIRTY));
+  unlink(slot);
+  free_slots.push_back(slot);
+  cache_sim_t::invalidate(line);
+}
+
+void fa_cache_sim_t::touch(uint64_t* line)
+{
+  if (policy == REPL_LRU) {
+    size_t slot = line - tags;
+    unlink(slot);
+    push_front(slot);
+  }
 }
 
 uint64_t fa_cache_sim_t::victimize(uint64_t addr)
 {
-  uint64_t old_tag = 0;
-  if (tags.size() == ways)
-  {
-    auto it = tags.begin();
-    std::advance(it, lfsr.next() % ways);
-    old_tag = it->second;
-    tags.erase(it);
+  size_t slot;
+  if (!free_slots.empty()) {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  } else if (used < ways) {
+    slot = used++;
+  } else {
+    slot = policy == REPL_RANDOM ? lfsr.next() % ways : tail;
+    unlink(slot);
+    index.erase(tags[slot] & ~(VALID | DIRTY));
   }
-  tags[addr >> idx_shift] = (addr >> idx_shift) | VALID;
+
+  uint64_t old_tag = tags[slot];
+  tags[slot] = (addr >> idx_shift) | VALID;
+  index[addr >> idx_shift] = slot;
+  push_front(slot);
   return old_tag;
 }
+
+bool coherence_directory_t::attach(cache_sim_t* cache, size_t* id)
+{
+  if (caches.size() == MAX_CACHES)
+    return false;
+  *id = caches.size();
+  caches.push_back(cache);
+  return true;
+}
+
+void coherence_directory_t::read_miss(uint64_t addr, size_t id)
+{
+  entry_t& e = lines[addr];
+  uint64_t self = uint64_t(1) << id;
+  if (e.modified && !(e.sharers & self)) {
+    caches[__builtin_ctzll(e.sharers)]->coherence_downgrade(addr);
+    downgrades++;
+    e.modified = false;
+  }
+  e.sharers |= self;
+}
+
+void coherence_directory_t::write(uint64_t addr, size_t id)
+{
+  entry_t& e = lines[addr];
+  uint64_t self = uint64_t(1) << id;
+  for (uint64_t others = e.sharers & ~self; others; others &= others - 1) {
+    caches[__builtin_ctzll(others)]->coherence_invalidate(addr);
+    invalidations++;
+  }
+  e.sharers = self;
+  e.modified = true;
+}
+
+void coherence_directory_t::evict(uint64_t addr, size_t id)
+{
+  auto it = lines.find(addr);
+  if (it == lines.end())
+    return;
+  it->second.sharers &= ~(uint64_t(1) << id);
+  if (!it->second.sharers)
+    lines.erase(it);
+}
+
+void coherence_directory_t::print_stats()
+{
+  if (invalidations + downgrades == 0)
+    return;
+
+  std::cout << "Coherence Invalidations:   " << invalidations << std::endl;
+  std::cout << "Coherence Downgrades:      " << downgrades << std::endl;
+}
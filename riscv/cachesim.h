@@ -6,7 +6,9 @@
 #include "memtracer.h"
 #include <cstring>
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <cstdint>
 
 class lfsr_t
@@ -19,10 +21,21 @@ class lfsr_t
   uint32_t reg;
 };
 
+typedef enum {
+  REPL_RANDOM,
+  REPL_LRU,
+  REPL_PLRU,   // tree pseudo-LRU
+  REPL_SRRIP,  // static re-reference interval prediction, 2-bit RRPVs
+  REPL_FIFO
+} replacement_policy_t;
+
+class coherence_directory_t;
+
 class cache_sim_t
 {
  public:
-  cache_sim_t(size_t sets, size_t ways, size_t linesz, const char* name);
+  cache_sim_t(size_t sets, size_t ways, size_t linesz, const char* name,
+              replacement_policy_t policy = REPL_RANDOM);
   cache_sim_t(const cache_sim_t& rhs);
   virtual ~cache_sim_t();
 
@@ -31,6 +44,13 @@ class cache_sim_t
   void print_stats();
   void set_miss_handler(cache_sim_t* mh) { miss_handler = mh; }
   void set_log(bool _log) { log = _log; }
+  uint64_t misses() const { return read_misses + write_misses; }
+  void set_directory(coherence_directory_t* dir);
+
+  // Called by the coherence directory on behalf of another cache: drop the
+  // line holding addr, or write it back and keep it clean.
+  void coherence_invalidate(uint64_t addr);
+  void coherence_downgrade(uint64_t addr);
 
   static cache_sim_t* construct(const char* config, const char* name);
 
@@ -40,6 +60,9 @@ class cache_sim_t
 
   virtual uint64_t* check_tag(uint64_t addr);
   virtual uint64_t victimize(uint64_t addr);
+  // Update replacement state for a hit on the given line.
+  virtual void touch(uint64_t* line);
+  virtual void invalidate(uint64_t* line) { *line &= ~(VALID | DIRTY); }
 
   lfsr_t lfsr;
   cache_sim_t* miss_handler;
@@ -48,8 +71,16 @@ class cache_sim_t
   size_t ways;
   size_t linesz;
   size_t idx_shift;
+  replacement_policy_t policy;
 
+  // The ways of each set are contiguous, so a lookup compares one run of
+  // tags.
   uint64_t* tags;
+  // Per-line replacement state: LRU timestamps or SRRIP RRPVs.
+  std::vector<uint64_t> line_state;
+  // Per-set replacement state: PLRU tree bits or the FIFO insertion pointer.
+  std::vector<uint64_t> set_state;
+  uint64_t lru_clock;
   
   uint64_t read_accesses;
   uint64_t read_misses;
@@ -62,18 +93,75 @@ class cache_sim_t
   std::string name;
   bool log;
 
+  coherence_directory_t* directory;
+  size_t directory_id;
+  uint64_t coherence_misses;
+  uint64_t coherence_invalidations;
+  // Lines invalidated by another cache's store and not yet missed on. An
+  // entry is dropped once its slot is refilled, so this is bounded by the
+  // number of lines in the cache.
+  std::unordered_set<uint64_t> invalidated_lines;
+
   void init();
+  size_t pick_victim(size_t idx);
+  void fill(size_t idx, size_t way);
+  void plru_touch(size_t idx, size_t way);
 };
 
+// Fully-associative cache: a hash index from line address to slot, and a
+// recency-ordered list of slots for LRU and FIFO replacement. Invalidated
+// slots are refilled before any valid line is evicted.
 class fa_cache_sim_t : public cache_sim_t
 {
  public:
-  fa_cache_sim_t(size_t ways, size_t linesz, const char* name);
+  fa_cache_sim_t(size_t ways, size_t linesz, const char* name,
+                 replacement_policy_t policy = REPL_RANDOM);
   uint64_t* check_tag(uint64_t addr);
   uint64_t victimize(uint64_t addr);
+  void touch(uint64_t* line);
+  void invalidate(uint64_t* line);
  private:
-  static bool cmp(uint64_t a, uint64_t b);
-  std::map<uint64_t, uint64_t> tags;
+  std::unordered_map<uint64_t, size_t> index;
+  std::vector<size_t> free_slots;
+  std::vector<size_t> prev;
+  std::vector<size_t> next;
+  size_t head; // most recently used or inserted
+  size_t tail;
+  size_t used;
+
+  void unlink(size_t slot);
+  void push_front(size_t slot);
+};
+
+// Tracks which private caches hold each line, MESI-style. A store
+// invalidates every other copy of the line; a miss on a line that another
+// cache holds modified makes that cache write it back first.
+class coherence_directory_t
+{
+ public:
+  coherence_directory_t() : invalidations(0), downgrades(0) {}
+  ~coherence_directory_t() { print_stats(); }
+
+  // Sharer sets are 64-bit masks.
+  static const size_t MAX_CACHES = 64;
+
+  // Returns false if the directory cannot track any more caches.
+  bool attach(cache_sim_t* cache, size_t* id);
+  void read_miss(uint64_t addr, size_t id);
+  void write(uint64_t addr, size_t id);
+  void evict(uint64_t addr, size_t id);
+  void print_stats();
+
+ private:
+  struct entry_t {
+    uint64_t sharers;
+    bool modified; // then sharers has exactly one bit set
+  };
+  // keyed by line address
+  std::unordered_map<uint64_t, entry_t> lines;
+  std::vector<cache_sim_t*> caches;
+  uint64_t invalidations;
+  uint64_t downgrades;
 };
 
 class cache_memtracer_t : public memtracer_t
@@ -91,6 +179,11 @@ class cache_memtracer_t : public memtracer_t
   {
     cache->set_miss_handler(mh);
   }
+  const cache_sim_t* get_cache() const { return cache; }
+  void set_directory(coherence_directory_t* dir)
+  {
+    cache->set_directory(dir);
+  }
   void clean_invalidate(uint64_t addr, size_t bytes, bool clean, bool inval)
   {
     cache->clean_invalidate(addr, bytes, clean, inval);
@@ -107,7 +200,7 @@ class cache_memtracer_t : public memtracer_t
 class icache_sim_t : public cache_memtracer_t
 {
  public:
-  icache_sim_t(const char* config) : cache_memtracer_t(config, "I$") {}
+  icache_sim_t(const char* config, const char* name = "I$") : cache_memtracer_t(config, name) {}
   bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
   {
     return type == FETCH;
@@ -121,7 +214,7 @@ class icache_sim_t : public cache_memtracer_t
 class dcache_sim_t : public cache_memtracer_t
 {
  public:
-  dcache_sim_t(const char* config) : cache_memtracer_t(config, "D$") {}
+  dcache_sim_t(const char* config, const char* name = "D$") : cache_memtracer_t(config, name) {}
   bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
   {
     return type == LOAD || type == STORE;
@@ -68,7 +68,9 @@ public:
       mem_layout(default_mem_layout),
       hartids(default_hartids),
       explicit_hartids(false),
-      real_time_clint(default_real_time_clint)
+      real_time_clint(default_real_time_clint),
+      real_time_clint_scale(1),
+      linux_user(false)
   {}
 
   cfg_arg_t<std::pair<reg_t, reg_t>> initrd_bounds;
@@ -81,6 +83,8 @@ public:
   cfg_arg_t<std::vector<int>>        hartids;
   bool                               explicit_hartids;
   cfg_arg_t<bool>                    real_time_clint;
+  uint64_t                           real_time_clint_scale;
+  bool                               linux_user;
 
   size_t nprocs() const { return hartids().size(); }
 };
@@ -1,16 +1,18 @@
-#include <sys/time.h>
+#include <time.h>
+#include <algorithm>
+#include <functional>
 #include "devices.h"
 #include "processor.h"
 
-clint_t::clint_t(std::vector<processor_t*>& procs, uint64_t freq_hz, bool real_time)
-  : procs(procs), freq_hz(freq_hz), real_time(real_time), mtime(0), mtimecmp(procs.size())
+clint_t::clint_t(std::vector<processor_t*>& procs, uint64_t freq_hz, bool real_time,
+                 uint64_t real_time_scale)
+  : procs(procs), freq_hz(freq_hz), real_time(real_time),
+    real_time_scale(real_time_scale), real_time_accesses(0), mtime(0),
+    mtimecmp(procs.size())
 {
-  struct timeval base;
+  clock_gettime(CLOCK_MONOTONIC, &real_time_ref);
 
-  gettimeofday(&base, NULL);
-
-  real_time_ref_secs = base.tv_sec;
-  real_time_ref_usecs = base.tv_usec;
+  reset_timers();
 }
 
 /* 0000 msip hart 0
@@ -31,10 +33,12 @@ bool clint_t::load(reg_t addr, size_t len, uint8_t* bytes)
 {
   increment(0);
   if (addr >= MSIP_BASE && addr + len <= MSIP_BASE + procs.size()*sizeof(msip_t)) {
-    std::vector<msip_t> msip(procs.size());
-    for (size_t i = 0; i < procs.size(); ++i)
-      msip[i] = !!(procs[i]->state.mip->read() & MIP_MSIP);
-    memcpy(bytes, (uint8_t*)&msip[0] + addr - MSIP_BASE, len);
+    // Only the low bit of each hart's msip word is implemented.
+    for (size_t i = 0; i < len; i++) {
+      reg_t offset = addr - MSIP_BASE + i;
+      bytes[i] = offset % sizeof(msip_t) == 0 &&
+                 (procs[offset / sizeof(msip_t)]->state.mip->read() & MIP_MSIP);
+    }
   } else if (addr >= MTIMECMP_BASE && addr + len <= MTIMECMP_BASE + procs.size()*sizeof(mtimecmp_t)) {
     memcpy(bytes, (uint8_t*)&mtimecmp[0] + addr - MTIMECMP_BASE, len);
   } else if (addr >= MTIME_BASE && addr + len <= MTIME_BASE + sizeof(mtime_t)) {
@@ -48,20 +52,20 @@ bool clint_t::load(reg_t addr, size_t len, uint8_t* bytes)
 bool clint_t::store(reg_t addr, size_t len, const uint8_t* bytes)
 {
   if (addr >= MSIP_BASE && addr + len <= MSIP_BASE + procs.size()*sizeof(msip_t)) {
-    std::vector<msip_t> msip(procs.size());
-    std::vector<msip_t> mask(procs.size(), 0);
-    memcpy((uint8_t*)&msip[0] + addr - MSIP_BASE, bytes, len);
-    memset((uint8_t*)&mask[0] + addr - MSIP_BASE, 0xff, len);
-    for (size_t i = 0; i < procs.size(); ++i) {
-      if (!(mask[i] & 0xFF)) continue;
-      procs[i]->state.mip->backdoor_write_with_mask(MIP_MSIP, 0);
-      if (!!(msip[i] & 1))
-        procs[i]->state.mip->backdoor_write_with_mask(MIP_MSIP, MIP_MSIP);
+    for (size_t i = 0; i < len; i++) {
+      reg_t offset = addr - MSIP_BASE + i;
+      if (offset % sizeof(msip_t) == 0)
+        procs[offset / sizeof(msip_t)]->state.mip->backdoor_write_with_mask(MIP_MSIP, (bytes[i] & 1) ? MIP_MSIP : 0);
     }
   } else if (addr >= MTIMECMP_BASE && addr + len <= MTIMECMP_BASE + procs.size()*sizeof(mtimecmp_t)) {
     memcpy((uint8_t*)&mtimecmp[0] + addr - MTIMECMP_BASE, bytes, len);
+    size_t first = (addr - MTIMECMP_BASE) / sizeof(mtimecmp_t);
+    size_t last = (addr + len - 1 - MTIMECMP_BASE) / sizeof(mtimecmp_t);
+    for (size_t i = first; i <= last; i++)
+      update_timer(i);
   } else if (addr >= MTIME_BASE && addr + len <= MTIME_BASE + sizeof(mtime_t)) {
     memcpy((uint8_t*)&mtime + addr - MTIME_BASE, bytes, len);
+    reset_timers();
   } else {
     return false;
   }
@@ -72,18 +76,75 @@ bool clint_t::store(reg_t addr, size_t len, const uint8_t* bytes)
 void clint_t::increment(reg_t inc)
 {
   if (real_time) {
-   struct timeval now;
-   uint64_t diff_usecs;
-
-   gettimeofday(&now, NULL);
-   diff_usecs = ((now.tv_sec - real_time_ref_secs) * 1000000) + (now.tv_usec - real_time_ref_usecs);
-   mtime = diff_usecs * freq_hz / 1000000;
+    // inc is 0 for CLINT accesses. Guests that spin on mtime make lots of
+    // those, so only sample the host clock every few of them.
+    if (inc == 0 && ++real_time_accesses < REAL_TIME_SAMPLE_INTERVAL)
+      return;
+    real_time_accesses = 0;
+    mtime = real_time_mtime();
   } else {
     mtime += inc;
   }
+
+  while (!deadlines.empty() && deadlines.front().first <= mtime) {
+    deadline_t d = deadlines.front();
+    std::pop_heap(deadlines.begin(), deadlines.end(), std::greater<deadline_t>());
+    deadlines.pop_back();
+    if (mtimecmp[d.second] == d.first)
+      procs[d.second]->state.mip->backdoor_write_with_mask(MIP_MTIP, MIP_MTIP);
+  }
+}
+
+void clint_t::skip_to_next_deadline()
+{
+  uint64_t deadline = next_deadline();
+  if (!real_time && deadline != UINT64_MAX && deadline > mtime)
+    increment(deadline - mtime);
+}
+
+void clint_t::update_timer(size_t i)
+{
+  if (mtime >= mtimecmp[i]) {
+    procs[i]->state.mip->backdoor_write_with_mask(MIP_MTIP, MIP_MTIP);
+    return;
+  }
+
+  procs[i]->state.mip->backdoor_write_with_mask(MIP_MTIP, 0);
+
+  // Superseded entries for far-off deadlines may never expire; rather than
+  // let them pile up, rebuild the heap once it holds a few per hart.
+  if (deadlines.size() >= 4 * procs.size()) {
+    reset_timers();
+    return;
+  }
+
+  deadlines.push_back(std::make_pair(mtimecmp[i], i));
+  std::push_heap(deadlines.begin(), deadlines.end(), std::greater<deadline_t>());
+}
+
+void clint_t::reset_timers()
+{
+  deadlines.clear();
   for (size_t i = 0; i < procs.size(); i++) {
-    procs[i]->state.mip->backdoor_write_with_mask(MIP_MTIP, 0);
-    if (mtime >= mtimecmp[i])
-      procs[i]->state.mip->backdoor_write_with_mask(MIP_MTIP, MIP_MTIP);
+    bool pending = mtime >= mtimecmp[i];
+    procs[i]->state.mip->backdoor_write_with_mask(MIP_MTIP, pending ? MIP_MTIP : 0);
+    if (!pending)
+      deadlines.push_back(std::make_pair(mtimecmp[i], i));
+  }
+  std::make_heap(deadlines.begin(), deadlines.end(), std::greater<deadline_t>());
+}
+
+clint_t::mtime_t clint_t::real_time_mtime()
+{
+  // CLOCK_MONOTONIC is served from the vDSO and never steps backwards.
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  uint64_t secs = now.tv_sec - real_time_ref.tv_sec;
+  int64_t nsecs = now.tv_nsec - real_time_ref.tv_nsec;
+  if (nsecs < 0) {
+    secs--;
+    nsecs += 1000000000;
   }
+  return (secs * freq_hz + nsecs * freq_hz / 1000000000) / real_time_scale;
 }
@@ -290,6 +290,9 @@ private:
       throw trap_virtual_instruction(insn.bits()); \
   } while (0);
 
+// Call softfloat's op, or its host FPU counterpart from host_fp.h.
+#define HOST_FP(op, ...) (p->host_fp_enabled() ? host_##op(__VA_ARGS__) : op(__VA_ARGS__))
+
 #define set_fp_exceptions ({ if (softfloat_exceptionFlags) { \
                                STATE.fflags->write(STATE.fflags->read() | softfloat_exceptionFlags); \
                              } \
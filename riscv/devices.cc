@@ -1,54 +1,100 @@
 #include "devices.h"
 #include "mmu.h"
+#include "arith.h"
+#include <algorithm>
 #include <stdexcept>
+#include <sys/mman.h>
 
 void bus_t::add_device(reg_t addr, abstract_device_t* dev)
 {
-  // Searching devices via lower_bound/upper_bound
-  // implicitly relies on the underlying std::map 
-  // container to sort the keys and provide ordered
-  // iteration over this sort, which it does. (python's
-  // SortedDict is a good analogy)
-  devices[addr] = dev;
+  // Keep the device table sorted by base address, replacing any device
+  // already registered at the same base.
+  auto it = std::lower_bound(devices.begin(), devices.end(), addr,
+    [](const device_range_t& range, reg_t addr) { return range.base < addr; });
+  if (it != devices.end() && it->base == addr)
+    it->dev = dev;
+  else
+    devices.insert(it, {addr, 0, dev});
+
+  // Each device serves addresses up to the base of the next one.
+  for (size_t i = 0; i < devices.size(); i++)
+    devices[i].end = i + 1 < devices.size() ? devices[i + 1].base : reg_t(-1);
+
+  last_hit = 0;
+  update_mem_ranges();
 }
 
-bool bus_t::load(reg_t addr, size_t len, uint8_t* bytes)
+void bus_t::update_mem_ranges()
+{
+  mem_ranges.clear();
+  for (auto& range : devices) {
+    auto mem = dynamic_cast<mem_t*>(range.dev);
+    if (!mem)
+      continue;
+
+    // A device based inside this memory shadows the rest of it.
+    reg_t end = std::min(range.base + mem->size(), range.end);
+    mem_ranges.push_back({range.base, end, mem});
+  }
+}
+
+char* bus_t::addr_to_mem(reg_t addr, bool write)
 {
+  auto it = std::upper_bound(mem_ranges.begin(), mem_ranges.end(), addr,
+    [](reg_t addr, const mem_range_t& range) { return addr < range.base; });
+  if (it == mem_ranges.begin())
+    return NULL;
+  it--;
+  if (addr >= it->end)
+    return NULL;
+  return write ? it->mem->contents_for_write(addr - it->base)
+               : it->mem->contents(addr - it->base);
+}
+
+bus_t::device_range_t bus_t::find_range(reg_t addr)
+{
+  // Device accesses tend to hit the same device repeatedly (e.g. polling a
+  // UART or mtime), so try the most recently found device first.
+  if (last_hit < devices.size()) {
+    auto& range = devices[last_hit];
+    if (addr >= range.base && addr < range.end)
+      return range;
+  }
+
   // Find the device with the base address closest to but
   // less than addr (price-is-right search)
-  auto it = devices.upper_bound(addr);
-  if (devices.empty() || it == devices.begin()) {
-    // Either the bus is empty, or there weren't 
+  auto it = std::upper_bound(devices.begin(), devices.end(), addr,
+    [](reg_t addr, const device_range_t& range) { return addr < range.base; });
+  if (it == devices.begin()) {
+    // Either the bus is empty, or there weren't
     // any items with a base address <= addr
-    return false;
+    return {0, 0, NULL};
   }
-  // Found at least one item with base address <= addr
-  // The iterator points to the device after this, so
-  // go back by one item.
   it--;
-  return it->second->load(addr - it->first, len, bytes);
+  last_hit = it - devices.begin();
+  return *it;
+}
+
+bool bus_t::load(reg_t addr, size_t len, uint8_t* bytes)
+{
+  auto range = find_range(addr);
+  if (!range.dev)
+    return false;
+  return range.dev->load(addr - range.base, len, bytes);
 }
 
 bool bus_t::store(reg_t addr, size_t len, const uint8_t* bytes)
 {
-  // See comments in bus_t::load
-  auto it = devices.upper_bound(addr);
-  if (devices.empty() || it == devices.begin()) {
+  auto range = find_range(addr);
+  if (!range.dev)
     return false;
-  }
-  it--;
-  return it->second->store(addr - it->first, len, bytes);
+  return range.dev->store(addr - range.base, len, bytes);
 }
 
 std::pair<reg_t, abstract_device_t*> bus_t::find_device(reg_t addr)
 {
-  // See comments in bus_t::load
-  auto it = devices.upper_bound(addr);
-  if (devices.empty() || it == devices.begin()) {
-    return std::make_pair((reg_t)0, (abstract_device_t*)NULL);
-  }
-  it--;
-  return std::make_pair(it->first, it->second);
+  auto range = find_range(addr);
+  return std::make_pair(range.base, range.dev);
 }
 
 // Type for holding all registered MMIO plugins by name.
@@ -91,17 +137,32 @@ bool mmio_plugin_device_t::store(reg_t addr, size_t len, const uint8_t* bytes)
   return (*plugin.store)(user_data, addr, len, bytes);
 }
 
-mem_t::mem_t(reg_t size)
-  : sz(size)
+mem_t::mem_t(reg_t size, bool hugepages)
+  : data(NULL), n_touched(0), sz(size)
 {
   if (size == 0 || size % PGSIZE != 0)
     throw std::runtime_error("memory size must be a positive multiple of 4 KiB");
+
+  if (size != (size_t)size)
+    throw std::bad_alloc();
+
+  void* res = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (res == MAP_FAILED)
+    throw std::bad_alloc();
+  data = (char*)res;
+
+#ifdef MADV_HUGEPAGE
+  if (hugepages)
+    madvise(data, size, MADV_HUGEPAGE);
+#endif
+
+  touched.resize((size / PGSIZE + 63) / 64);
 }
 
 mem_t::~mem_t()
 {
-  for (auto& entry : sparse_memory_map)
-    free(entry.second);
+  munmap(data, sz);
 }
 
 bool mem_t::load_store(reg_t addr, size_t len, uint8_t* bytes, bool store)
@@ -109,31 +170,49 @@ bool mem_t::load_store(reg_t addr, size_t len, uint8_t* bytes, bool store)
   if (addr + len < addr || addr + len > sz)
     return false;
 
-  while (len > 0) {
-    auto n = std::min(PGSIZE - (addr % PGSIZE), reg_t(len));
-
-    if (store)
-      memcpy(this->contents(addr), bytes, n);
-    else
-      memcpy(bytes, this->contents(addr), n);
-
-    addr += n;
-    bytes += n;
-    len -= n;
+  if (store) {
+    for (reg_t ppn = addr >> PGSHIFT; len && ppn <= (addr + len - 1) >> PGSHIFT; ppn++)
+      touch(ppn);
+    memcpy(data + addr, bytes, len);
+  } else {
+    memcpy(bytes, data + addr, len);
   }
 
   return true;
 }
 
-char* mem_t::contents(reg_t addr) {
-  reg_t ppn = addr >> PGSHIFT, pgoff = addr % PGSIZE;
-  auto search = sparse_memory_map.find(ppn);
-  if (search == sparse_memory_map.end()) {
-    auto res = (char*)calloc(PGSIZE, 1);
-    if (res == nullptr)
-      throw std::bad_alloc();
-    sparse_memory_map[ppn] = res;
-    return res + pgoff;
+char* mem_t::contents_for_write(reg_t addr)
+{
+  touch(addr >> PGSHIFT);
+  return data + addr;
+}
+
+size_t mem_t::map_file(reg_t addr, int fd, size_t off, size_t len)
+{
+  if (addr % PGSIZE != 0 || off % PGSIZE != 0 || addr > sz || len > sz - addr)
+    return 0;
+
+  len &= ~(size_t)(PGSIZE - 1);
+  if (len == 0)
+    return 0;
+
+  void* res = mmap(data + addr, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_FIXED, fd, off);
+  if (res == MAP_FAILED)
+    return 0;
+
+  for (reg_t ppn = addr >> PGSHIFT; ppn < (addr + len) >> PGSHIFT; ppn++)
+    touch(ppn);
+
+  return len;
+}
+
+void mem_t::for_each_touched_page(std::function<void(reg_t addr, const char* page)> f) const
+{
+  for (size_t i = 0; i < touched.size(); i++) {
+    for (uint64_t word = touched[i]; word; word &= word - 1) {
+      reg_t addr = (i * 64 + ctz(word)) << PGSHIFT;
+      f(addr, data + addr);
+    }
   }
-  return search->second + pgoff;
 }
@@ -5,11 +5,14 @@
 #include "mmio_plugin.h"
 #include "abstract_device.h"
 #include "platform.h"
+#include <functional>
 #include <map>
 #include <vector>
 #include <utility>
+#include <time.h>
 
 class processor_t;
+class mem_t;
 
 class bus_t : public abstract_device_t {
  public:
@@ -19,8 +22,36 @@ class bus_t : public abstract_device_t {
 
   std::pair<reg_t, abstract_device_t*> find_device(reg_t addr);
 
+  // A device together with the address range [base, end) it serves; dev is
+  // NULL if no device is mapped.
+  struct device_range_t {
+    reg_t base;
+    reg_t end;
+    abstract_device_t* dev;
+  };
+  device_range_t find_range(reg_t addr);
+
+  // Return the host address backing addr if it is served by a mem_t, or NULL.
+  // A caller that will write through the result must say so, so that the
+  // page is accounted as touched.
+  char* addr_to_mem(reg_t addr, bool write = false);
+
  private:
-  std::map<reg_t, abstract_device_t*> devices;
+  void update_mem_ranges();
+
+  // Devices sorted by base address, with the index of the last one found.
+  std::vector<device_range_t> devices;
+  size_t last_hit = 0;
+
+  // Address ranges [base, end) that resolve to RAM, sorted by base. This is
+  // rebuilt whenever a device is added, so that translation does not need to
+  // search the device map or query device types.
+  struct mem_range_t {
+    reg_t base;
+    reg_t end;
+    mem_t* mem;
+  };
+  std::vector<mem_range_t> mem_ranges;
 };
 
 class rom_device_t : public abstract_device_t {
@@ -33,42 +64,85 @@ class rom_device_t : public abstract_device_t {
   std::vector<char> data;
 };
 
+// Target memory is a single lazily-populated host mapping, so untouched
+// pages are supplied (as zeroes) by the host kernel on first access.
 class mem_t : public abstract_device_t {
  public:
-  mem_t(reg_t size);
+  mem_t(reg_t size, bool hugepages = false);
   mem_t(const mem_t& that) = delete;
   ~mem_t();
 
   bool load(reg_t addr, size_t len, uint8_t* bytes) { return load_store(addr, len, bytes, false); }
   bool store(reg_t addr, size_t len, const uint8_t* bytes) { return load_store(addr, len, const_cast<uint8_t*>(bytes), true); }
-  char* contents(reg_t addr);
+  char* contents(reg_t addr) { return data + addr; }
+  char* contents_for_write(reg_t addr);
   reg_t size() { return sz; }
 
+  // Map the whole pages of [off, off+len) of file fd copy-on-write at addr,
+  // replacing the current contents. Returns the number of bytes mapped, which
+  // is 0 if addr or off is not page aligned or the mapping fails.
+  size_t map_file(reg_t addr, int fd, size_t off, size_t len);
+
+  // Pages that have been written, or handed out for writing. This is a
+  // superset of the pages that may hold nonzero data.
+  reg_t touched_pages() const { return n_touched; }
+  void for_each_touched_page(std::function<void(reg_t addr, const char* page)> f) const;
+
  private:
   bool load_store(reg_t addr, size_t len, uint8_t* bytes, bool store);
+  void touch(reg_t ppn)
+  {
+    uint64_t bit = uint64_t(1) << (ppn % 64);
+    if (!(touched[ppn / 64] & bit)) {
+      touched[ppn / 64] |= bit;
+      n_touched++;
+    }
+  }
 
-  std::map<reg_t, char*> sparse_memory_map;
+  char* data;
+  std::vector<uint64_t> touched;
+  reg_t n_touched;
   reg_t sz;
 };
 
 class clint_t : public abstract_device_t {
  public:
-  clint_t(std::vector<processor_t*>&, uint64_t freq_hz, bool real_time);
+  // With real_time, mtime follows the host clock slowed down by
+  // real_time_scale; otherwise it advances only through increment().
+  clint_t(std::vector<processor_t*>&, uint64_t freq_hz, bool real_time,
+          uint64_t real_time_scale = 1);
   bool load(reg_t addr, size_t len, uint8_t* bytes);
   bool store(reg_t addr, size_t len, const uint8_t* bytes);
   size_t size() { return CLINT_SIZE; }
   void increment(reg_t inc);
+  // Re-evaluate the timer interrupt of procs[i], e.g. after it was reset.
+  void update_timer(size_t i);
+  // No timer interrupt becomes pending before mtime reaches this value.
+  uint64_t next_deadline() const {
+    return deadlines.empty() ? UINT64_MAX : deadlines.front().first;
+  }
+  // Advance mtime to next_deadline(), for when every hart is waiting for
+  // an interrupt. A real-time clock keeps to the host clock instead.
+  void skip_to_next_deadline();
  private:
   typedef uint64_t mtime_t;
   typedef uint64_t mtimecmp_t;
   typedef uint32_t msip_t;
+  typedef std::pair<mtimecmp_t, size_t> deadline_t;
   std::vector<processor_t*>& procs;
   uint64_t freq_hz;
   bool real_time;
-  uint64_t real_time_ref_secs;
-  uint64_t real_time_ref_usecs;
+  uint64_t real_time_scale;
+  struct timespec real_time_ref;
+  static const unsigned REAL_TIME_SAMPLE_INTERVAL = 32;
+  unsigned real_time_accesses; // CLINT accesses since the last clock sample
   mtime_t mtime;
   std::vector<mtimecmp_t> mtimecmp;
+  // Min-heap of (mtimecmp, hart) for harts whose MTIP is clear. Entries
+  // superseded by a later mtimecmp write are dropped when they expire.
+  std::vector<deadline_t> deadlines;
+  void reset_timers();
+  mtime_t real_time_mtime();
 };
 
 class mmio_plugin_device_t : public abstract_device_t {
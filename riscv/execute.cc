@@ -3,6 +3,7 @@
 #include "processor.h"
 #include "mmu.h"
 #include "disasm.h"
+#include "timing_model.h"
 #include <cassert>
 
 #ifdef RISCV_ENABLE_COMMITLOG
@@ -219,7 +220,7 @@ bool processor_t::slow_path()
 }
 
 // fetch/decode/execute loop
-void processor_t::step(size_t n)
+size_t processor_t::step(size_t n)
 {
   if (!state.debug_mode) {
     if (halt_request == HR_REGULAR) {
@@ -232,6 +233,17 @@ void processor_t::step(size_t n)
     }
   }
 
+  if (unlikely(in_wfi)) {
+    if (!state.debug_mode && !(state.mip->read() & state.mie->read()))
+      return 0;
+    in_wfi = false;
+  }
+
+  // Misses other harts made in shared caches are not ours to pay for.
+  if (timing)
+    timing->sync_caches();
+
+  size_t retired = 0;
   while (n > 0) {
     size_t instret = 0;
     reg_t pc = state.pc;
@@ -259,7 +271,7 @@ void processor_t::step(size_t n)
       if (unlikely(slow_path()))
       {
         // Main simulation loop, slow path.
-        while (instret < n)
+        while (instret < n && !yield_requested)
         {
           if (unlikely(!state.serialized && state.single_step == state.STEP_STEPPED)) {
             state.single_step = state.STEP_NONE;
@@ -277,20 +289,26 @@ void processor_t::step(size_t n)
           insn_fetch_t fetch = mmu->load_insn(pc);
           if (debug && !state.serialized)
             disasm(fetch.insn);
+          reg_t insn_pc = pc;
           pc = execute_insn(this, pc, fetch);
+          if (timing && pc != PC_SERIALIZE_BEFORE)
+            timing->retire(insn_pc, fetch.insn, invalid_pc(pc) ? state.pc : pc);
           advance_pc();
         }
       }
-      else while (instret < n)
+      else while (instret < n && !yield_requested)
       {
         // Main simulation loop, fast path.
         for (auto ic_entry = _mmu->access_icache(pc); ; ) {
           auto fetch = ic_entry->data;
+          reg_t insn_pc = pc;
           pc = execute_insn(this, pc, fetch);
+          if (unlikely(timing != NULL) && pc != PC_SERIALIZE_BEFORE)
+            timing->retire(insn_pc, fetch.insn, invalid_pc(pc) ? state.pc : pc);
           ic_entry = ic_entry->next;
           if (unlikely(ic_entry->tag != pc))
             break;
-          if (unlikely(instret + 1 == n))
+          if (unlikely(instret + 1 == n || yield_requested))
             break;
           instret++;
           state.pc = pc;
@@ -321,8 +339,7 @@ void processor_t::step(size_t n)
         pc = execute_insn(this, pc, fetch);
         advance_pc();
 
-        delete mmu->matched_trigger;
-        mmu->matched_trigger = NULL;
+        mmu->matched_trigger.reset();
       }
       switch (t.action) {
         case triggers::ACTION_DEBUG_MODE:
@@ -344,15 +361,33 @@ void processor_t::step(size_t n)
       //
       // In the debug ROM this prevents us from wasting time looping, but also
       // allows us to switch to other threads only once per idle loop in case
-      // there is activity.
+      // there is activity. Outside debug mode, the hart then sleeps until
+      // an interrupt wakes it.
       n = ++instret;
+      if (!state.debug_mode)
+        in_wfi = true;
     }
 
-    state.minstret->bump(instret);
+    if (unlikely(yield_requested)) {
+      yield_requested = false;
+      n = instret;
+    }
 
-    // Model a hart whose CPI is 1.
-    state.mcycle->bump(instret);
+    state.minstret->bump(instret);
+    retired += instret;
+
+    if (timing) {
+      // Charge the cache misses made so far before mcycle can be read.
+      mmu->flush_trace();
+      state.mcycle->bump(timing->take_cycles());
+    } else {
+      // Model a hart whose CPI is 1.
+      state.mcycle->bump(instret);
+    }
 
     n -= instret;
   }
+
+  mmu->flush_trace();
+  return retired;
 }
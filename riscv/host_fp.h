@@ -0,0 +1,212 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_HOST_FP_H
+#define _RISCV_HOST_FP_H
+
+// Scalar F and D arithmetic on the host FPU.
+//
+// Each host_f32_* and host_f64_* function takes and returns the same values
+// as the softfloat function it is named after, and raises the same softfloat
+// exception flags. It computes on the host when the rounding mode is
+// round-to-nearest-even and the host result alone proves the outcome: such
+// a result can only be inexact, which an error-free transformation (TwoSum,
+// or the exact residual of a product, quotient or root) detects without
+// touching the host floating-point environment. NaNs, infinities, overflow,
+// and results small enough to underflow or to make the residual inexact all
+// fall back to softfloat.
+
+#include "softfloat.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__FLT_EVAL_METHOD__) && __FLT_EVAL_METHOD__ == 0
+#define HOST_FP_SUPPORTED 1
+#else
+#define HOST_FP_SUPPORTED 0
+#endif
+
+template<class T, class S>
+static inline T host_fp_in(S f)
+{
+  T x;
+  static_assert(sizeof(x) == sizeof(f.v), "host and softfloat widths differ");
+  memcpy(&x, &f.v, sizeof(x));
+  return x;
+}
+
+template<class S, class T>
+static inline S host_fp_out(T x, bool inexact)
+{
+  S f;
+  memcpy(&f.v, &x, sizeof(x));
+  if (inexact)
+    softfloat_exceptionFlags |= softfloat_flag_inexact;
+  return f;
+}
+
+static inline bool host_fp_rne()
+{
+  return HOST_FP_SUPPORTED && softfloat_roundingMode == softfloat_round_near_even;
+}
+
+// Magnitudes of at least 2^(emin + n * p), below which the residual of a
+// product (n = 1) or of a quotient or root (n = 2) may not be representable.
+template<class T, int n>
+static inline T host_fp_floor()
+{
+  const T scale = (T)(UINT64_C(1) << std::numeric_limits<T>::digits);
+  return n == 1 ? std::numeric_limits<T>::min() * scale
+                : std::numeric_limits<T>::min() * scale * scale;
+}
+
+template<class T>
+static inline bool host_fp_add(T a, T b, T& r, bool& inexact)
+{
+  r = a + b;
+  if (!std::isfinite(r))
+    return false;
+  const T bb = r - a;
+  inexact = ((a - (r - bb)) + (b - bb)) != 0;
+  return true;
+}
+
+template<class T>
+static inline bool host_fp_mul(T a, T b, T& r, bool& inexact)
+{
+  r = a * b;
+  if (r == 0) {
+    inexact = false;
+    return a == 0 || b == 0;
+  }
+  if (!std::isfinite(r) || std::fabs(r) < host_fp_floor<T, 1>())
+    return false;
+  inexact = std::fma(a, b, -r) != 0;
+  return true;
+}
+
+template<class T>
+static inline bool host_fp_div(T a, T b, T& r, bool& inexact)
+{
+  if (b == 0 || !std::isfinite(a) || !std::isfinite(b))
+    return false;
+  r = a / b;
+  if (a == 0) {
+    inexact = false;
+    return true;
+  }
+  if (!std::isfinite(r) || std::fabs(r) < host_fp_floor<T, 1>() ||
+      std::fabs(a) < host_fp_floor<T, 2>())
+    return false;
+  inexact = std::fma(-r, b, a) != 0;
+  return true;
+}
+
+template<class T>
+static inline bool host_fp_sqrt(T a, T& r, bool& inexact)
+{
+  if (!(a == 0 || (a >= host_fp_floor<T, 2>() && std::isfinite(a))))
+    return false;
+  r = std::sqrt(a);
+  inexact = a != 0 && std::fma(-r, r, a) != 0;
+  return true;
+}
+
+// a * b + c by the host FMA, with the residual found by ErrFma (Boldo and
+// Muller): a * b + c == r + r2 + r3 exactly, with r2 the rounded sum of
+// gamma and alpha2, so r is exact if and only if that sum is zero.
+template<class T>
+static inline bool host_fp_mul_add(T a, T b, T c, T& r, bool& inexact)
+{
+  if (!std::isfinite(a) || !std::isfinite(b) || !std::isfinite(c))
+    return false;
+  r = std::fma(a, b, c);
+  const T u1 = a * b;
+  if (u1 == 0 && (a == 0 || b == 0)) {
+    inexact = false;
+    return true;
+  }
+  if (!std::isfinite(r) || !std::isfinite(u1) || std::fabs(r) < host_fp_floor<T, 1>() ||
+      std::fabs(u1) < host_fp_floor<T, 1>())
+    return false;
+  const T u2 = std::fma(a, b, -u1);
+  const T alpha1 = c + u2;
+  const T cc = alpha1 - c;
+  const T alpha2 = (c - (alpha1 - cc)) + (u2 - cc);
+  const T beta1 = u1 + alpha1;
+  const T uu = beta1 - u1;
+  const T beta2 = (u1 - (beta1 - uu)) + (alpha1 - uu);
+  const T gamma = (beta1 - r) + beta2;
+  inexact = gamma + alpha2 != 0;
+  return true;
+}
+
+// Single precision products are exact in double precision.
+static inline bool host_fp_f32_round(double s, float& r, bool& inexact)
+{
+  if (s != 0 && std::fabs(s) < std::numeric_limits<float>::min())
+    return false;
+  r = (float)s;
+  if (!std::isfinite(r))
+    return false;
+  inexact = (double)r != s;
+  return true;
+}
+
+#define HOST_FP_DEFINE(type, T, name, params, args, body) \
+  static inline type host_##name params \
+  { \
+    if (host_fp_rne()) { \
+      T r; \
+      bool inexact; \
+      if (body) \
+        return host_fp_out<type>(r, inexact); \
+    } \
+    return name args; \
+  }
+
+HOST_FP_DEFINE(float32_t, float, f32_add, (float32_t a, float32_t b), (a, b),
+  host_fp_add(host_fp_in<float>(a), host_fp_in<float>(b), r, inexact))
+HOST_FP_DEFINE(float32_t, float, f32_sub, (float32_t a, float32_t b), (a, b),
+  host_fp_add(host_fp_in<float>(a), -host_fp_in<float>(b), r, inexact))
+HOST_FP_DEFINE(float32_t, float, f32_mul, (float32_t a, float32_t b), (a, b),
+  host_fp_f32_round((double)host_fp_in<float>(a) * host_fp_in<float>(b), r, inexact))
+HOST_FP_DEFINE(float32_t, float, f32_div, (float32_t a, float32_t b), (a, b),
+  host_fp_div(host_fp_in<float>(a), host_fp_in<float>(b), r, inexact))
+HOST_FP_DEFINE(float32_t, float, f32_sqrt, (float32_t a), (a),
+  host_fp_sqrt(host_fp_in<float>(a), r, inexact))
+
+HOST_FP_DEFINE(float64_t, double, f64_add, (float64_t a, float64_t b), (a, b),
+  host_fp_add(host_fp_in<double>(a), host_fp_in<double>(b), r, inexact))
+HOST_FP_DEFINE(float64_t, double, f64_sub, (float64_t a, float64_t b), (a, b),
+  host_fp_add(host_fp_in<double>(a), -host_fp_in<double>(b), r, inexact))
+HOST_FP_DEFINE(float64_t, double, f64_mul, (float64_t a, float64_t b), (a, b),
+  host_fp_mul(host_fp_in<double>(a), host_fp_in<double>(b), r, inexact))
+HOST_FP_DEFINE(float64_t, double, f64_div, (float64_t a, float64_t b), (a, b),
+  host_fp_div(host_fp_in<double>(a), host_fp_in<double>(b), r, inexact))
+HOST_FP_DEFINE(float64_t, double, f64_sqrt, (float64_t a), (a),
+  host_fp_sqrt(host_fp_in<double>(a), r, inexact))
+HOST_FP_DEFINE(float64_t, double, f64_mulAdd, (float64_t a, float64_t b, float64_t c), (a, b, c),
+  host_fp_mul_add(host_fp_in<double>(a), host_fp_in<double>(b), host_fp_in<double>(c), r, inexact))
+
+// The sum of a single precision product and addend is s + e exactly, in
+// double precision, and is tiny exactly when s is.
+static inline float32_t host_f32_mulAdd(float32_t a, float32_t b, float32_t c)
+{
+  if (host_fp_rne()) {
+    const float x = host_fp_in<float>(a), y = host_fp_in<float>(b), z = host_fp_in<float>(c);
+    double s;
+    bool sum_inexact;
+    if (host_fp_add((double)x * y, (double)z, s, sum_inexact) &&
+        !(s != 0 && std::fabs(s) < std::numeric_limits<float>::min())) {
+      const float r = std::fma(x, y, z);
+      if (std::isfinite(r))
+        return host_fp_out<float32_t>(r, sum_inexact || (double)r != s);
+    }
+  }
+  return f32_mulAdd(a, b, c);
+}
+
+#undef HOST_FP_DEFINE
+
+#endif
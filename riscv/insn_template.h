@@ -3,6 +3,7 @@
 #include "arith.h"
 #include "mmu.h"
 #include "softfloat.h"
+#include "host_fp.h"
 #include "internals.h"
 #include "specialize.h"
 #include "tracer.h"
@@ -1,3 +1,3 @@
-P_LOOP(16, {
+P_SWAR_LOOP(16, add, {
   pd = ps1 + ps2;
 })
@@ -1,5 +1,5 @@
 require_extension('F');
 require_fp;
 softfloat_roundingMode = RM;
-WRITE_FRD(f32_div(f32(FRS1), f32(FRS2)));
+WRITE_FRD(HOST_FP(f32_div, f32(FRS1), f32(FRS2)));
 set_fp_exceptions;
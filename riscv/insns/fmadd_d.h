@@ -1,5 +1,5 @@
 require_extension('D');
 require_fp;
 softfloat_roundingMode = RM;
-WRITE_FRD(f64_mulAdd(f64(FRS1), f64(FRS2), f64(FRS3)));
+WRITE_FRD(HOST_FP(f64_mulAdd, f64(FRS1), f64(FRS2), f64(FRS3)));
 set_fp_exceptions;
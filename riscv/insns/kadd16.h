@@ -1,5 +1,5 @@
 require_vector_vs;
-P_LOOP(16, {
+P_SWAR_LOOP(16, kadd, {
   bool sat = false;
   pd = (sat_add<int16_t, uint16_t>(ps1, ps2, sat));
   P_SET_OV(sat);
@@ -1,5 +1,5 @@
 require_vector_vs;
-P_STRAIGHT_ULOOP(16, {
+P_SWAR_STRAIGHT_ULOOP(16, kadd, ksub, {
   bool sat = false;
   pd = (sat_add<int16_t, uint16_t>(ps1, ps2, sat));
   P_SET_OV(sat);
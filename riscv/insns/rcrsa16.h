@@ -1,4 +1,4 @@
-P_CROSS_LOOP(16, {
+P_SWAR_CROSS_LOOP(16, rsub, radd, {
   pd = (ps1 - ps2) >> 1;
 }, {
   pd = (ps1 + ps2) >> 1;
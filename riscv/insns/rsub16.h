@@ -1,3 +1,3 @@
-P_LOOP(16, {
+P_SWAR_LOOP(16, rsub, {
   pd = (ps1 - ps2) >> 1;
 })
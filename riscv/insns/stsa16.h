@@ -1,4 +1,4 @@
-P_STRAIGHT_LOOP(16, {
+P_SWAR_STRAIGHT_LOOP(16, sub, add, {
   pd = ps1 - ps2;
 }, {
   pd = ps1 + ps2;
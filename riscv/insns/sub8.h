@@ -1,3 +1,3 @@
-P_LOOP(8, {
+P_SWAR_LOOP(8, sub, {
   pd = ps1 - ps2;
 })
@@ -1,5 +1,5 @@
 require_vector_vs;
-P_ULOOP(8, {
+P_SWAR_ULOOP(8, ukadd, {
   bool sat = false;
   pd = (sat_addu<uint8_t>(ps1, ps2, sat));
   P_SET_OV(sat);
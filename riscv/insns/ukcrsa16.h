@@ -1,5 +1,5 @@
 require_vector_vs;
-P_CROSS_ULOOP(16, {
+P_SWAR_CROSS_ULOOP(16, uksub, ukadd, {
   bool sat = false;
   pd = (sat_subu<uint16_t>(ps1, ps2, sat));
   P_SET_OV(sat);
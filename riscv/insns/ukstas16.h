@@ -1,5 +1,5 @@
 require_vector_vs;
-P_STRAIGHT_ULOOP(16, {
+P_SWAR_STRAIGHT_ULOOP(16, ukadd, uksub, {
   bool sat = false;
   pd = (sat_addu<uint16_t>(ps1, ps2, sat));
   P_SET_OV(sat);
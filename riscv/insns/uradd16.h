@@ -1,3 +1,3 @@
-P_ULOOP(16, {
+P_SWAR_ULOOP(16, uradd, {
   pd = (ps1 + ps2) >> 1;
 })
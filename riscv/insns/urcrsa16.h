@@ -1,4 +1,4 @@
-P_CROSS_ULOOP(16, {
+P_SWAR_CROSS_ULOOP(16, ursub, uradd, {
   pd = (ps1 - ps2) >> 1;
 }, {
   pd = (ps1 + ps2) >> 1;
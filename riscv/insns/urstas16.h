@@ -1,4 +1,4 @@
-P_STRAIGHT_ULOOP(16, {
+P_SWAR_STRAIGHT_ULOOP(16, uradd, ursub, {
   pd = (ps1 + ps2) >> 1;
 }, {
   pd = (ps1 - ps2) >> 1;
@@ -1,3 +1,3 @@
-P_ULOOP(8, {
+P_SWAR_ULOOP(8, ursub, {
   pd = (ps1 - ps2) >> 1;
 })
@@ -1,5 +1,5 @@
 // vadd.vi vd, simm5, vs2, vm
-VI_VI_LOOP
+VI_VI_SIMD_LOOP
 ({
   vd = simm5 + vs2;
 })
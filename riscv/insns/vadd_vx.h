@@ -1,5 +1,5 @@
 // vadd.vx vd, rs1, vs2, vm
-VI_VX_LOOP
+VI_VX_SIMD_LOOP
 ({
   vd = rs1 + vs2;
 })
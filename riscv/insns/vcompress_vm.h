@@ -7,27 +7,17 @@ require_noover(insn.rd(), P.VU.vflmul, insn.rs1(), 1);
 
 reg_t pos = 0;
 
-VI_GENERAL_LOOP_BASE
-  const int midx = i / 64;
-  const int mpos = i % 64;
-
-  bool do_mask = (P.VU.elt<uint64_t>(rs1_num, midx) >> mpos) & 0x1;
-  if (do_mask) {
-    switch (sew) {
-    case e8:
-      P.VU.elt<uint8_t>(rd_num, pos, true) = P.VU.elt<uint8_t>(rs2_num, i);
-      break;
-    case e16:
-      P.VU.elt<uint16_t>(rd_num, pos, true) = P.VU.elt<uint16_t>(rs2_num, i);
-      break;
-    case e32:
-      P.VU.elt<uint32_t>(rd_num, pos, true) = P.VU.elt<uint32_t>(rs2_num, i);
-      break;
-    default:
-      P.VU.elt<uint64_t>(rd_num, pos, true) = P.VU.elt<uint64_t>(rs2_num, i);
-      break;
-    }
-
-    ++pos;
+VI_GENERAL_LOOP_VARS
+// Scan vs1 a word at a time, moving each run of selected elements at once.
+for (reg_t midx = 0; midx * 64 < vl; ++midx) {
+  uint64_t sel = VI_MASK_WORD(rs1_num, midx, false) & mask_word_range(midx, 0, vl);
+  while (sel) {
+    const int start = ctz(sel);
+    const uint64_t rest = ~(sel >> start);
+    const int len = rest ? ctz(rest) : 64 - start;
+    VI_ELT_MOVE(rd_num, pos, rs2_num, midx * 64 + start, (reg_t)len);
+    pos += len;
+    sel &= len + start >= 64 ? 0 : UINT64_MAX << (start + len);
   }
-VI_LOOP_END;
+}
+P.VU.vstart->write(0);
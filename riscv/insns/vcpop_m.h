@@ -6,18 +6,12 @@ reg_t sew = P.VU.vsew;
 reg_t rd_num = insn.rd();
 reg_t rs2_num = insn.rs2();
 require(P.VU.vstart->read() == 0);
-reg_t popcount = 0;
-for (reg_t i=P.VU.vstart->read(); i<vl; ++i) {
-  const int midx = i / 32;
-  const int mpos = i % 32;
-
-  bool vs2_lsb = ((P.VU.elt<uint32_t>(rs2_num, midx ) >> mpos) & 0x1) == 1;
-  if (insn.v_vm() == 1) {
-    popcount += vs2_lsb;
-  } else {
-    bool do_mask = (P.VU.elt<uint32_t>(0, midx) >> mpos) & 0x1;
-    popcount += (vs2_lsb && do_mask);
-  }
+reg_t cnt = 0;
+for (reg_t midx = 0; midx * 64 < vl; ++midx) {
+  uint64_t vs2 = VI_MASK_WORD(rs2_num, midx, false) & mask_word_range(midx, 0, vl);
+  if (insn.v_vm() == 0)
+    vs2 &= VI_MASK_WORD(0, midx, false);
+  cnt += popcount(vs2);
 }
 P.VU.vstart->write(0);
-WRITE_RD(popcount);
+WRITE_RD(cnt);
@@ -1,6 +1,9 @@
 // vfadd.vf vd, vs2, rs1
-VI_VFP_VF_LOOP
+VI_VFP_VF_HOST_LOOP
 ({
+  vd = rs1 + vs2;
+},
+{
   vd = f16_add(rs1, vs2);
 },
 {
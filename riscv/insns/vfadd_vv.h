@@ -1,6 +1,9 @@
 // vfadd.vv vd, vs2, vs1
-VI_VFP_VV_LOOP
+VI_VFP_VV_HOST_LOOP
 ({
+  vd = vs1 + vs2;
+},
+{
   vd = f16_add(vs1, vs2);
 },
 {
@@ -1,6 +1,9 @@
 // vfdiv.vf vd, vs2, rs1
-VI_VFP_VF_LOOP
+VI_VFP_VF_HOST_LOOP
 ({
+  vd = vs2 / rs1;
+},
+{
   vd = f16_div(vs2, rs1);
 },
 {
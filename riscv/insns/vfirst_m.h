@@ -7,12 +7,12 @@ reg_t rd_num = insn.rd();
 reg_t rs2_num = insn.rs2();
 require(P.VU.vstart->read() == 0);
 reg_t pos = -1;
-for (reg_t i=P.VU.vstart->read(); i < vl; ++i) {
-  VI_LOOP_ELEMENT_SKIP()
-
-  bool vs2_lsb = ((P.VU.elt<uint64_t>(rs2_num, midx ) >> mpos) & 0x1) == 1;
-  if (vs2_lsb) {
-    pos = i;
+for (reg_t midx = 0; midx * 64 < vl; ++midx) {
+  uint64_t vs2 = VI_MASK_WORD(rs2_num, midx, false) & mask_word_range(midx, 0, vl);
+  if (insn.v_vm() == 0)
+    vs2 &= VI_MASK_WORD(0, midx, false);
+  if (vs2) {
+    pos = midx * 64 + ctz(vs2);
     break;
   }
 }
@@ -1,6 +1,9 @@
 // vfmacc.vf vd, rs1, vs2, vm    # vd[i] = +(vs2[i] * x[rs1]) + vd[i]
-VI_VFP_VF_LOOP
+VI_VFP_VF_HOST_LOOP
 ({
+  vd = VI_VFP_HOST_FMA(rs1, vs2, vd);
+},
+{
   vd = f16_mulAdd(rs1, vs2, vd);
 },
 {
@@ -1,6 +1,9 @@
 // vfmacc.vv vd, rs1, vs2, vm    # vd[i] = +(vs2[i] * vs1[i]) + vd[i]
-VI_VFP_VV_LOOP
+VI_VFP_VV_HOST_LOOP
 ({
+  vd = VI_VFP_HOST_FMA(vs1, vs2, vd);
+},
+{
   vd = f16_mulAdd(vs1, vs2, vd);
 },
 {
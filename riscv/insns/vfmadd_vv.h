@@ -1,6 +1,9 @@
 // vfmadd: vd[i] = +(vd[i] * vs1[i]) + vs2[i]
-VI_VFP_VV_LOOP
+VI_VFP_VV_HOST_LOOP
 ({
+  vd = VI_VFP_HOST_FMA(vd, vs1, vs2);
+},
+{
   vd = f16_mulAdd(vd, vs1, vs2);
 },
 {
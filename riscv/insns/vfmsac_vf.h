@@ -1,6 +1,9 @@
 // vfmsac: vd[i] = +(f[rs1] * vs2[i]) - vd[i]
-VI_VFP_VF_LOOP
+VI_VFP_VF_HOST_LOOP
 ({
+  vd = VI_VFP_HOST_FMA(rs1, vs2, -vd);
+},
+{
   vd = f16_mulAdd(rs1, vs2, f16(vd.v ^ F16_SIGN));
 },
 {
@@ -1,6 +1,9 @@
 // vfmsac: vd[i] = +(vs1[i] * vs2[i]) - vd[i]
-VI_VFP_VV_LOOP
+VI_VFP_VV_HOST_LOOP
 ({
+  vd = VI_VFP_HOST_FMA(vs1, vs2, -vd);
+},
+{
   vd = f16_mulAdd(vs1, vs2, f16(vd.v ^ F16_SIGN));
 },
 {
@@ -1,6 +1,9 @@
 // vfmsub: vd[i] = +(vd[i] * f[rs1]) - vs2[i]
-VI_VFP_VF_LOOP
+VI_VFP_VF_HOST_LOOP
 ({
+  vd = VI_VFP_HOST_FMA(vd, rs1, -vs2);
+},
+{
   vd = f16_mulAdd(vd, rs1, f16(vs2.v ^ F16_SIGN));
 },
 {
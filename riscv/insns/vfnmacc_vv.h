@@ -1,6 +1,9 @@
 // vfnmacc: vd[i] = -(vs1[i] * vs2[i]) - vd[i]
-VI_VFP_VV_LOOP
+VI_VFP_VV_HOST_LOOP
 ({
+  vd = VI_VFP_HOST_FMA(-vs2, vs1, -vd);
+},
+{
   vd = f16_mulAdd(f16(vs2.v ^ F16_SIGN), vs1, f16(vd.v ^ F16_SIGN));
 },
 {
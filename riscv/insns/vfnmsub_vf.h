@@ -1,6 +1,9 @@
 // vfnmsub: vd[i] = -(vd[i] * f[rs1]) + vs2[i]
-VI_VFP_VF_LOOP
+VI_VFP_VF_HOST_LOOP
 ({
+  vd = VI_VFP_HOST_FMA(-vd, rs1, vs2);
+},
+{
   vd = f16_mulAdd(f16(vd.v ^ F16_SIGN), rs1, vs2);
 },
 {
@@ -1,6 +1,6 @@
 // vfredosum: vd[0] =  sum( vs2[*] , vs1[0] )
 bool is_propagate = false;
-VI_VFP_VV_LOOP_REDUCTION
+VI_VFP_VV_HOST_LOOP_REDUCTION_SUM
 ({
   vd_0 = f16_add(vd_0, vs2);
 },
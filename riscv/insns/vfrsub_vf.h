@@ -1,6 +1,9 @@
 // vfsub.vf vd, vs2, rs1
-VI_VFP_VF_LOOP
+VI_VFP_VF_HOST_LOOP
 ({
+  vd = rs1 - vs2;
+},
+{
   vd = f16_sub(rs1, vs2);
 },
 {
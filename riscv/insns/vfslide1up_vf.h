@@ -3,6 +3,11 @@ VI_CHECK_SLIDE(true);
 
 VI_VFP_LOOP_BASE
 if (i != 0) {
+  if (insn.v_vm() == 1) {
+    VI_ELT_MOVE(rd_num, i, rs2_num, i - 1, vl - i);
+    break;
+  }
+
   switch (P.VU.vsew) {
     case e16: {
       VI_XI_SLIDEUP_PARAMS(e16, 1);
@@ -1,6 +1,9 @@
 // vfsub.vf vd, vs2, rs1
-VI_VFP_VF_LOOP
+VI_VFP_VF_HOST_LOOP
 ({
+  vd = vs2 - rs1;
+},
+{
   vd = f16_sub(vs2, rs1);
 },
 {
@@ -1,6 +1,9 @@
 // vfsub.vv vd, vs2, vs1
-VI_VFP_VV_LOOP
+VI_VFP_VV_HOST_LOOP
 ({
+  vd = vs2 - vs1;
+},
+{
   vd = f16_sub(vs2, vs1);
 },
 {
@@ -11,43 +11,32 @@ require_vm;
 require_align(rd_num, P.VU.vflmul);
 require_noover(rd_num, P.VU.vflmul, rs2_num, 1);
 
-int cnt = 0;
-for (reg_t i = 0; i < vl; ++i) {
-  const int midx = i / 64;
-  const int mpos = i % 64;
+reg_t cnt = 0;
+for (reg_t midx = 0; midx * 64 < vl; ++midx) {
+  uint64_t active = mask_word_range(midx, 0, vl);
+  if (insn.v_vm() == 0)
+    active &= VI_MASK_WORD(0, midx, false);
+  const uint64_t vs2 = VI_MASK_WORD(rs2_num, midx, false);
 
-  bool vs2_lsb = ((P.VU.elt<uint64_t>(rs2_num, midx) >> mpos) & 0x1) == 1;
-  bool do_mask = (P.VU.elt<uint64_t>(0, midx) >> mpos) & 0x1;
+  for (; active; active &= active - 1) {
+    const int mpos = ctz(active);
+    const reg_t i = midx * 64 + mpos;
 
-  bool has_one = false;
-  if (insn.v_vm() == 1 || (insn.v_vm() == 0 && do_mask)) {
-    if (vs2_lsb) {
-      has_one = true;
+    switch (sew) {
+    case e8:
+      P.VU.elt<uint8_t>(rd_num, i, true) = cnt;
+      break;
+    case e16:
+      P.VU.elt<uint16_t>(rd_num, i, true) = cnt;
+      break;
+    case e32:
+      P.VU.elt<uint32_t>(rd_num, i, true) = cnt;
+      break;
+    default:
+      P.VU.elt<uint64_t>(rd_num, i, true) = cnt;
+      break;
     }
-  }
-
-  bool use_ori = (insn.v_vm() == 0) && !do_mask;
-  switch (sew) {
-  case e8:
-    P.VU.elt<uint8_t>(rd_num, i, true) = use_ori ?
-                                   P.VU.elt<uint8_t>(rd_num, i) : cnt;
-    break;
-  case e16:
-    P.VU.elt<uint16_t>(rd_num, i, true) = use_ori ?
-                                    P.VU.elt<uint16_t>(rd_num, i) : cnt;
-    break;
-  case e32:
-    P.VU.elt<uint32_t>(rd_num, i, true) = use_ori ?
-                                    P.VU.elt<uint32_t>(rd_num, i) : cnt;
-    break;
-  default:
-    P.VU.elt<uint64_t>(rd_num, i, true) = use_ori ?
-                                    P.VU.elt<uint64_t>(rd_num, i) : cnt;
-    break;
-  }
 
-  if (has_one) {
-    cnt++;
+    cnt += (vs2 >> mpos) & 0x1;
   }
 }
-
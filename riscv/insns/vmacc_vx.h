@@ -1,5 +1,5 @@
 // vmacc.vx: vd[i] = +(x[rs1] * vs2[i]) + vd[i]
-VI_VX_LOOP
+VI_VX_SIMD_LOOP
 ({
   vd = rs1 * vs2 + vd;
 })
@@ -1,5 +1,5 @@
 // vmadd: vd[i] = (vd[i] * x[rs1]) + vs2[i]
-VI_VX_LOOP
+VI_VX_SIMD_LOOP
 ({
   vd = vd * rs1 + vs2;
 })
@@ -1,10 +1,5 @@
 // vmax.vv vd, vs2, vs1, vm   # Vector-vector
-VI_VV_LOOP
+VI_VV_SIMD_LOOP
 ({
-  if (vs1 >= vs2) {
-    vd = vs1;
-  } else {
-    vd = vs2;
-  }
-
+  vd = vs1 >= vs2 ? vs1 : vs2;
 })
@@ -1,9 +1,5 @@
 // vmaxu.vx vd, vs2, rs1, vm   # vector-scalar
-VI_VX_ULOOP
+VI_VX_SIMD_ULOOP
 ({
-  if (rs1 >= vs2) {
-    vd = rs1;
-  } else {
-    vd = vs2;
-  }
+  vd = rs1 >= vs2 ? rs1 : vs2;
 })
@@ -1,11 +1,5 @@
 // vminx.vx vd, vs2, rs1, vm   # vector-scalar
-VI_VX_LOOP
+VI_VX_SIMD_LOOP
 ({
-  if (rs1 <= vs2) {
-    vd = rs1;
-  } else {
-    vd = vs2;
-  }
-
-
+  vd = rs1 <= vs2 ? rs1 : vs2;
 })
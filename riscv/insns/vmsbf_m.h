@@ -10,23 +10,18 @@ reg_t rd_num = insn.rd();
 reg_t rs2_num = insn.rs2();
 
 bool has_one = false;
-for (reg_t i = P.VU.vstart->read(); i < vl; ++i) {
-  const int midx = i / 64;
-  const int mpos = i % 64;
-  const uint64_t mmask = UINT64_C(1) << mpos; \
+for (reg_t midx = 0; midx * 64 < vl; ++midx) {
+  uint64_t active = mask_word_range(midx, 0, vl);
+  if (insn.v_vm() == 0)
+    active &= VI_MASK_WORD(0, midx, false);
+  const uint64_t vs2 = VI_MASK_WORD(rs2_num, midx, false) & active;
+  const uint64_t first = vs2 & -vs2;
 
-  bool vs2_lsb = ((P.VU.elt<uint64_t>(rs2_num, midx) >> mpos) & 0x1) == 1;
-  bool do_mask = (P.VU.elt<uint64_t>(0, midx) >> mpos) & 0x1;
-
-
-  if (insn.v_vm() == 1 || (insn.v_vm() == 0 && do_mask)) {
-    auto &vd = P.VU.elt<uint64_t>(rd_num, midx, true);
-    uint64_t res = 0;
-    if (!has_one && !vs2_lsb) {
-      res = 1;
-    } else if(!has_one && vs2_lsb) {
-      has_one = true;
-    }
-    vd = (vd & ~mmask) | ((res << mpos) & mmask);
+  uint64_t res = 0;
+  if (!has_one) {
+    res = vs2 ? first - 1 : UINT64_MAX;
+    has_one = vs2 != 0;
   }
+  uint64_t &vd = VI_MASK_WORD(rd_num, midx, true);
+  vd = (vd & ~active) | (res & active);
 }
@@ -9,8 +9,11 @@ require_align(vs2, len);
 const reg_t size = len * P.VU.vlenb;
 const reg_t start = P.VU.vstart->read() * (P.VU.vsew >> 3);
 
-//register needs one-by-one copy to keep commitlog correct
-if (vd != vs2 && start < size) {
+if (VI_HOST_SIMD && vd != vs2 && start < size) {
+  memcpy(P.VU.elt_group<char>(vd) + start,
+         P.VU.elt_group<char>(vs2) + start, size - start);
+} else if (vd != vs2 && start < size) {
+  //register needs one-by-one copy to keep commitlog correct
   reg_t i = start / P.VU.vlenb;
   reg_t off = start % P.VU.vlenb;
   if (off) {
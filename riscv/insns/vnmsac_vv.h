@@ -1,5 +1,5 @@
 // vmsac.vv: vd[i] = -(vs1[i] * vs2[i]) + vd[i]
-VI_VV_LOOP
+VI_VV_SIMD_LOOP
 ({
   vd = -(vs1 * vs2) + vd;
 })
@@ -1,5 +1,5 @@
 // vnmsub.vv: vd[i] = -(vd[i] * vs1[i]) + vs2[i]
-VI_VV_LOOP
+VI_VV_SIMD_LOOP
 ({
   vd = -(vd * vs1) + vs2;
 })
@@ -1,5 +1,5 @@
 // vor
-VI_VI_LOOP
+VI_VI_SIMD_LOOP
 ({
   vd = simm5 | vs2;
 })
@@ -3,6 +3,14 @@ VI_CHECK_SLIDE(false);
 
 VI_LOOP_BASE
 if (i != vl - 1) {
+  // All but the last element move at once; the last is written by the
+  // next iteration.
+  if (insn.v_vm() == 1) {
+    VI_ELT_MOVE(rd_num, i, rs2_num, i + 1, vl - 1 - i);
+    i = vl - 2;
+    continue;
+  }
+
   switch (sew) {
   case e8: {
     VI_XI_SLIDEDOWN_PARAMS(e8, 1);
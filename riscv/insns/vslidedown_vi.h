@@ -7,6 +7,15 @@ VI_LOOP_BASE
 reg_t offset = 0;
 bool is_valid = (i + sh) < P.VU.vlmax;
 
+// Move the run of elements that have a source at once, leaving any
+// elements past it to be zeroed by the following iterations.
+if (insn.v_vm() == 1 && is_valid) {
+  const reg_t n = std::min<reg_t>(vl, P.VU.vlmax - sh) - i;
+  VI_ELT_MOVE(rd_num, i, rs2_num, i + (reg_t)sh, n);
+  i += n - 1;
+  continue;
+}
+
 if (is_valid) {
   offset = sh;
 }
@@ -3,6 +3,13 @@ VI_CHECK_SLIDE(true);
 
 const reg_t offset = RS1;
 VI_LOOP_BASE
+if (insn.v_vm() == 1) {
+  const reg_t start = std::max(i, offset);
+  if (start < vl)
+    VI_ELT_MOVE(rd_num, start, rs2_num, start - offset, vl - start);
+  break;
+}
+
 if (P.VU.vstart->read() < offset && i < offset)
   continue;
 
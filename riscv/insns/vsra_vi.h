@@ -1,5 +1,5 @@
 // vsra.vi vd, vs2, zimm5
-VI_VI_LOOP
+VI_VI_SIMD_LOOP
 ({
   vd = vs2 >> (simm5 & (sew - 1) & 0x1f);
 })
@@ -1,5 +1,5 @@
 // vsra.vx vd, vs2, rs1
-VI_VX_LOOP
+VI_VX_SIMD_LOOP
 ({
   vd = vs2 >> (rs1 & (sew - 1));
 })
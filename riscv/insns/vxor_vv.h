@@ -1,5 +1,5 @@
 // vxor
-VI_VV_LOOP
+VI_VV_SIMD_LOOP
 ({
   vd = vs1 ^ vs2;
 })
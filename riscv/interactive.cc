@@ -132,6 +132,7 @@ void sim_t::interactive()
   funcs["pc"] = &sim_t::interactive_pc;
   funcs["mem"] = &sim_t::interactive_mem;
   funcs["str"] = &sim_t::interactive_str;
+  funcs["pages"] = &sim_t::interactive_pages;
   funcs["until"] = &sim_t::interactive_until_silent;
   funcs["untiln"] = &sim_t::interactive_until_noisy;
   funcs["while"] = &sim_t::interactive_until_silent;
@@ -140,7 +141,7 @@ void sim_t::interactive()
   funcs["help"] = &sim_t::interactive_help;
   funcs["h"] = funcs["help"];
 
-  while (!done())
+  while (!exit_requested())
   {
 #ifdef HAVE_BOOST_ASIO
     boost::asio::streambuf bout; // socket output
@@ -213,6 +214,7 @@ void sim_t::interactive_help(const std::string& cmd, const std::vector<std::stri
     "pc <core>                       # Show current PC in <core>\n"
     "mem <hex addr>                  # Show contents of physical memory\n"
     "str <core> <hex addr>           # Show NUL-terminated C string at <hex addr> in core <core>\n"
+    "pages                           # List the ranges of physical memory that have been written\n"
     "until reg <core> <reg> <val>    # Stop when <reg> in <core> hits <val>\n"
     "until pc <core> <val>           # Stop when PC in <core> hits <val>\n"
     "untiln pc <core> <val>          # Run noisy and stop when PC in <core> hits <val>\n"
@@ -246,7 +248,7 @@ void sim_t::interactive_run(const std::string& cmd, const std::vector<std::strin
   size_t steps = args.size() ? atoll(args[0].c_str()) : -1;
   ctrlc_pressed = false;
   set_procs_debug(noisy);
-  for (size_t i = 0; i < steps && !ctrlc_pressed && !done(); i++)
+  for (size_t i = 0; i < steps && !ctrlc_pressed && !exit_requested(); i++)
     step(1);
 
   std::ostream out(sout_.rdbuf());
@@ -513,6 +515,31 @@ void sim_t::interactive_str(const std::string& cmd, const std::vector<std::strin
   out << std::endl;
 }
 
+void sim_t::interactive_pages(const std::string& cmd, const std::vector<std::string>& args)
+{
+  std::ostream out(sout_.rdbuf());
+
+  for (auto& mem : mems) {
+    out << std::hex << "0x" << mem.first << ": " << std::dec
+        << mem.second->touched_pages() << " pages written" << std::endl;
+
+    // Coalesce runs of consecutive pages.
+    reg_t start = 0, end = 0;
+    auto print_range = [&]() {
+      if (end != start)
+        out << std::hex << "  0x" << mem.first + start << "-0x" << mem.first + end << std::endl;
+    };
+    mem.second->for_each_touched_page([&](reg_t addr, const char* page) {
+      if (addr != end) {
+        print_range();
+        start = addr;
+      }
+      end = addr + PGSIZE;
+    });
+    print_range();
+  }
+}
+
 void sim_t::interactive_until_silent(const std::string& cmd, const std::vector<std::string>& args)
 {
   interactive_until(cmd, args, false);
@@ -568,7 +595,7 @@ void sim_t::interactive_until(const std::string& cmd, const std::vector<std::str
 
       if (cmd_until == (current == val))
         break;
-      if (ctrlc_pressed)
+      if (ctrlc_pressed || exit_requested())
         break;
     }
     catch (trap_t& t) {}
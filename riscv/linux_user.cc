@@ -0,0 +1,1415 @@
+// See LICENSE for license details.
+
+#include "linux_user.h"
+#include "mmu.h"
+#include "processor.h"
+#include "simif.h"
+#include "trap.h"
+#include "byteorder.h"
+#include "elf.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+extern char** environ;
+
+#ifndef ET_DYN
+#define ET_DYN 3
+#endif
+#ifndef PT_INTERP
+#define PT_INTERP 3
+#endif
+#ifndef PF_X
+#define PF_X 1
+#define PF_W 2
+#define PF_R 4
+#endif
+
+// The user half of the Sv39 address space ends at 2^38. The stack sits at
+// the top of it, anonymous mappings grow down from below the stack, and
+// position-independent executables are loaded well above the heap.
+static const reg_t USER_TOP = reg_t(1) << 38;
+static const reg_t STACK_SIZE = 8 << 20;
+static const reg_t MMAP_TOP = USER_TOP - (reg_t(1) << 30);
+static const reg_t ET_DYN_BASE = 0x2aaaaaa000;
+
+// Marks a leaf PTE that owns a page, whether or not it is currently valid.
+static const reg_t PTE_ALLOCATED = 0x100;
+
+// Linux generic ABI constants. Errno values, the access mode of open flags,
+// and the remaining arguments passed through to the host use the same
+// encoding on every Linux host.
+static const int TARGET_PROT_READ = 1;
+static const int TARGET_PROT_WRITE = 2;
+static const int TARGET_PROT_EXEC = 4;
+static const int TARGET_MAP_FIXED = 0x10;
+static const int TARGET_MAP_ANONYMOUS = 0x20;
+static const int TARGET_AT_FDCWD = -100;
+static const int TARGET_O_ACCMODE = 03;
+static const int TARGET_O_LARGEFILE = 0100000;
+static const int TARGET_O_CLOEXEC = 02000000;
+static const int TARGET_F_DUPFD = 0;
+static const int TARGET_F_GETFD = 1;
+static const int TARGET_F_SETFD = 2;
+static const int TARGET_F_GETFL = 3;
+static const int TARGET_F_SETFL = 4;
+static const int TARGET_F_DUPFD_CLOEXEC = 1030;
+static const int TARGET_FD_CLOEXEC = 1;
+static const reg_t TARGET_TIOCGWINSZ = 0x5413;
+static const int TARGET_RLIMIT_STACK = 3;
+static const reg_t TARGET_CLONE_VM = 0x100;
+static const reg_t TARGET_CLONE_THREAD = 0x10000;
+static const reg_t TARGET_CLONE_SETTLS = 0x80000;
+static const reg_t TARGET_CLONE_PARENT_SETTID = 0x100000;
+static const reg_t TARGET_CLONE_CHILD_CLEARTID = 0x200000;
+static const reg_t TARGET_CLONE_CHILD_SETTID = 0x1000000;
+static const int TARGET_FUTEX_WAIT = 0;
+static const int TARGET_FUTEX_WAKE = 1;
+static const int TARGET_FUTEX_REQUEUE = 3;
+static const int TARGET_FUTEX_CMP_REQUEUE = 4;
+static const int TARGET_FUTEX_WAIT_BITSET = 9;
+static const int TARGET_FUTEX_WAKE_BITSET = 10;
+static const int TARGET_FUTEX_PRIVATE_FLAG = 128;
+static const int TARGET_FUTEX_CLOCK_REALTIME = 256;
+
+// The other open flags differ between architectures; aarch64, for one,
+// swaps O_DIRECTORY, O_NOFOLLOW, O_DIRECT and O_LARGEFILE around.
+static const struct {
+  int target;
+  int host;
+} open_flags[] = {
+  {0100, O_CREAT},
+  {0200, O_EXCL},
+  {0400, O_NOCTTY},
+  {01000, O_TRUNC},
+  {02000, O_APPEND},
+  {04000, O_NONBLOCK},
+  {010000, O_DSYNC},
+  {020000, O_ASYNC},
+#ifdef O_DIRECT
+  {040000, O_DIRECT},
+#endif
+  {0200000, O_DIRECTORY},
+  {0400000, O_NOFOLLOW},
+#ifdef O_NOATIME
+  {01000000, O_NOATIME},
+#endif
+  {TARGET_O_CLOEXEC, O_CLOEXEC},
+  {04000000, O_SYNC & ~O_DSYNC},
+#ifdef O_PATH
+  {010000000, O_PATH},
+#endif
+#ifdef O_TMPFILE
+  {020000000, O_TMPFILE & ~O_DIRECTORY},
+#endif
+};
+
+enum {
+  TARGET_NR_getcwd = 17,
+  TARGET_NR_dup = 23,
+  TARGET_NR_dup3 = 24,
+  TARGET_NR_fcntl = 25,
+  TARGET_NR_ioctl = 29,
+  TARGET_NR_mkdirat = 34,
+  TARGET_NR_unlinkat = 35,
+  TARGET_NR_faccessat = 48,
+  TARGET_NR_openat = 56,
+  TARGET_NR_close = 57,
+  TARGET_NR_lseek = 62,
+  TARGET_NR_read = 63,
+  TARGET_NR_write = 64,
+  TARGET_NR_readv = 65,
+  TARGET_NR_writev = 66,
+  TARGET_NR_pread64 = 67,
+  TARGET_NR_pwrite64 = 68,
+  TARGET_NR_readlinkat = 78,
+  TARGET_NR_newfstatat = 79,
+  TARGET_NR_fstat = 80,
+  TARGET_NR_exit = 93,
+  TARGET_NR_exit_group = 94,
+  TARGET_NR_set_tid_address = 96,
+  TARGET_NR_futex = 98,
+  TARGET_NR_set_robust_list = 99,
+  TARGET_NR_clock_gettime = 113,
+  TARGET_NR_sched_yield = 124,
+  TARGET_NR_rt_sigaction = 134,
+  TARGET_NR_rt_sigprocmask = 135,
+  TARGET_NR_uname = 160,
+  TARGET_NR_gettimeofday = 169,
+  TARGET_NR_getpid = 172,
+  TARGET_NR_getppid = 173,
+  TARGET_NR_getuid = 174,
+  TARGET_NR_geteuid = 175,
+  TARGET_NR_getgid = 176,
+  TARGET_NR_getegid = 177,
+  TARGET_NR_gettid = 178,
+  TARGET_NR_brk = 214,
+  TARGET_NR_munmap = 215,
+  TARGET_NR_mremap = 216,
+  TARGET_NR_clone = 220,
+  TARGET_NR_mmap = 222,
+  TARGET_NR_mprotect = 226,
+  TARGET_NR_madvise = 233,
+  TARGET_NR_prlimit64 = 261,
+  TARGET_NR_getrandom = 278,
+};
+
+enum {
+  AT_NULL = 0,
+  AT_PHDR = 3,
+  AT_PHENT = 4,
+  AT_PHNUM = 5,
+  AT_PAGESZ = 6,
+  AT_BASE = 7,
+  AT_FLAGS = 8,
+  AT_ENTRY = 9,
+  AT_UID = 11,
+  AT_EUID = 12,
+  AT_GID = 13,
+  AT_EGID = 14,
+  AT_HWCAP = 16,
+  AT_CLKTCK = 17,
+  AT_SECURE = 23,
+  AT_RANDOM = 25,
+  AT_EXECFN = 31,
+};
+
+// struct stat as laid out by the generic Linux ABI.
+struct target_stat
+{
+  uint64_t dev;
+  uint64_t ino;
+  uint32_t mode;
+  uint32_t nlink;
+  uint32_t uid;
+  uint32_t gid;
+  uint64_t rdev;
+  uint64_t __pad1;
+  int64_t size;
+  int32_t blksize;
+  int32_t __pad2;
+  int64_t blocks;
+  int64_t atime;
+  uint64_t atime_nsec;
+  int64_t mtime;
+  uint64_t mtime_nsec;
+  int64_t ctime;
+  uint64_t ctime_nsec;
+  uint32_t __unused4;
+  uint32_t __unused5;
+};
+
+static reg_t page_round_up(reg_t addr)
+{
+  return (addr + PGSIZE - 1) & ~reg_t(PGSIZE - 1);
+}
+
+static reg_t sysret_errno(sreg_t ret)
+{
+  return ret == -1 ? -errno : ret;
+}
+
+static int host_open_flags(reg_t flags)
+{
+  int host = flags & TARGET_O_ACCMODE;
+  for (auto& f : open_flags)
+    if (flags & f.target)
+      host |= f.host;
+  return host;
+}
+
+static reg_t target_open_flags(int flags)
+{
+  // 64-bit Linux opens every file with O_LARGEFILE.
+  reg_t target = (flags & O_ACCMODE) | TARGET_O_LARGEFILE;
+  for (auto& f : open_flags)
+    if (f.host && (flags & f.host) == f.host)
+      target |= f.target;
+  return target;
+}
+
+static reg_t pte_bits(int prot)
+{
+  reg_t bits = PTE_U | PTE_A | PTE_D | PTE_ALLOCATED;
+  // Write-only pages are a reserved encoding, so writable implies readable.
+  if (prot & (TARGET_PROT_READ | TARGET_PROT_WRITE))
+    bits |= PTE_R;
+  if (prot & TARGET_PROT_WRITE)
+    bits |= PTE_W;
+  if (prot & TARGET_PROT_EXEC)
+    bits |= PTE_X;
+  if (bits & (PTE_R | PTE_X))
+    bits |= PTE_V;
+  return bits;
+}
+
+// Transfer between fd and a list of host buffers, as one read/write call
+// would. With off >= 0 this is a positioned transfer.
+static reg_t host_rwv(int fd, const std::vector<struct iovec>& iov, bool write, off_t off)
+{
+  reg_t total = 0;
+  for (size_t i = 0; i < iov.size(); ) {
+    size_t cnt = off < 0 ? std::min(iov.size() - i, size_t(IOV_MAX)) : 1;
+    ssize_t ret;
+    if (off >= 0)
+      ret = write ? pwrite(fd, iov[i].iov_base, iov[i].iov_len, off + total)
+                  : pread(fd, iov[i].iov_base, iov[i].iov_len, off + total);
+    else
+      ret = write ? writev(fd, &iov[i], cnt) : readv(fd, &iov[i], cnt);
+
+    if (ret < 0)
+      return total ? total : -errno;
+
+    size_t want = 0;
+    for (size_t j = i; j < i + cnt; j++)
+      want += iov[j].iov_len;
+
+    total += ret;
+    i += cnt;
+    if (size_t(ret) < want)
+      break;
+  }
+  return total;
+}
+
+linux_user_t::linux_user_t(simif_t* sim, const std::vector<processor_t*>& procs,
+                           reg_t mem_base, reg_t mem_size)
+  : sim(sim), procs(procs), mem_next(mem_base), mem_end(mem_base + mem_size),
+    brk_start(0), brk_cur(0), mmap_next(MMAP_TOP), done(false), status(0),
+    threads(procs.size(), thread_t()), next_tid(getpid())
+{
+  root_table = alloc_page();
+
+  // The target gets copies of the standard streams.
+  for (int fd = 0; fd <= 2; fd++)
+    fds.push_back(dup(fd));
+}
+
+linux_user_t::~linux_user_t()
+{
+  for (int hfd : fds)
+    if (hfd >= 0)
+      close(hfd);
+}
+
+void linux_user_t::terminate(int code)
+{
+  done = true;
+  status = code;
+  for (auto p : procs)
+    p->set_waiting(true);
+}
+
+void linux_user_t::exit_thread(size_t hart, int code)
+{
+  thread_t& t = threads[hart];
+  if (t.clear_child_tid) {
+    uint32_t zero = 0;
+    if (copy_out(t.clear_child_tid, &zero, sizeof(zero)))
+      futex_wake(t.clear_child_tid, 1, ~uint32_t(0));
+  }
+  t = thread_t();
+  procs[hart]->set_waiting(true);
+
+  for (auto& other : threads) {
+    if (other.tid) {
+      check_deadlock();
+      return;
+    }
+  }
+  terminate(code);
+}
+
+size_t linux_user_t::futex_wake(reg_t uaddr, size_t count, uint32_t bitset)
+{
+  size_t woken = 0;
+  for (size_t i = 0; i < threads.size() && woken < count; i++) {
+    thread_t& t = threads[i];
+    if (t.futex && t.futex == uaddr && (t.futex_bitset & bitset)) {
+      t.futex = 0;
+      t.futex_timed = false;
+      procs[i]->set_waiting(false);
+      woken++;
+    }
+  }
+  return woken;
+}
+
+void linux_user_t::check_deadlock()
+{
+  for (auto& t : threads)
+    if (t.tid && (!t.futex || t.futex_timed))
+      return;
+
+  fprintf(stderr, "%s: every thread is waiting on a futex\n", exe_path.c_str());
+  terminate(128 + SIGKILL);
+}
+
+// Nanoseconds from now on clock to deadline, or 0 if it has passed.
+static uint64_t ns_until(clockid_t clock, const struct timespec& deadline)
+{
+  struct timespec now;
+  clock_gettime(clock, &now);
+  if (now.tv_sec > deadline.tv_sec ||
+      (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))
+    return 0;
+  // Far-off deadlines need only be later than any sleep we would take.
+  int64_t sec = std::min<int64_t>(deadline.tv_sec - now.tv_sec, 1000000);
+  return uint64_t(sec) * 1000000000 + deadline.tv_nsec - now.tv_nsec;
+}
+
+void linux_user_t::tick()
+{
+  if (done)
+    return;
+
+  bool running = false;
+  uint64_t sleep_ns = UINT64_MAX;
+  for (size_t i = 0; i < threads.size(); i++) {
+    thread_t& t = threads[i];
+    if (!t.tid)
+      continue;
+    if (!t.futex) {
+      running = true;
+    } else if (t.futex_timed) {
+      uint64_t ns = ns_until(t.futex_clock, t.futex_deadline);
+      if (ns == 0) {
+        t.futex = 0;
+        t.futex_timed = false;
+        procs[i]->get_state()->XPR.write(10, -ETIMEDOUT);
+        procs[i]->set_waiting(false);
+        running = true;
+      }
+      sleep_ns = std::min(sleep_ns, ns);
+    }
+  }
+
+  // With nothing to run until a timeout, wait for it on the host, rather
+  // than spinning through rounds of idle harts.
+  if (!running && sleep_ns != UINT64_MAX) {
+    struct timespec ts;
+    ts.tv_sec = sleep_ns / 1000000000;
+    ts.tv_nsec = sleep_ns % 1000000000;
+    nanosleep(&ts, nullptr);
+  }
+}
+
+void linux_user_t::flush_tlbs()
+{
+  for (auto p : procs)
+    p->get_mmu()->flush_tlb();
+}
+
+int linux_user_t::host_fd(reg_t fd)
+{
+  return fd < fds.size() ? fds[fd] : -1;
+}
+
+int linux_user_t::host_dirfd(reg_t dirfd)
+{
+  return int(dirfd) == TARGET_AT_FDCWD ? AT_FDCWD : host_fd(dirfd);
+}
+
+// Give the host descriptor hfd the lowest free target descriptor that is
+// at least min_fd, or close it if there is none.
+reg_t linux_user_t::install_fd(int hfd, reg_t min_fd)
+{
+  if (hfd < 0)
+    return -errno;
+
+  struct rlimit rl;
+  reg_t limit = getrlimit(RLIMIT_NOFILE, &rl) == 0 ? rl.rlim_cur : reg_t(INT_MAX);
+  reg_t fd = min_fd;
+  while (fd < fds.size() && fds[fd] >= 0)
+    fd++;
+  if (fd >= limit) {
+    close(hfd);
+    return -EMFILE;
+  }
+
+  if (fd >= fds.size())
+    fds.resize(fd + 1, -1);
+  fds[fd] = hfd;
+  return fd;
+}
+
+reg_t linux_user_t::alloc_page()
+{
+  if (!free_pages.empty()) {
+    reg_t paddr = free_pages.back();
+    free_pages.pop_back();
+    memset(page_mem(paddr, true), 0, PGSIZE);
+    return paddr;
+  }
+
+  // Target memory starts out zeroed, so fresh pages need no clearing.
+  if (mem_next + PGSIZE > mem_end)
+    return 0;
+  reg_t paddr = mem_next;
+  mem_next += PGSIZE;
+  return paddr;
+}
+
+char* linux_user_t::page_mem(reg_t paddr, bool write)
+{
+  return write ? sim->addr_to_mem_for_write(paddr) : sim->addr_to_mem(paddr);
+}
+
+uint64_t* linux_user_t::walk(reg_t vaddr, bool create)
+{
+  reg_t table = root_table;
+  for (int level = 2; level > 0; level--) {
+    uint64_t* pte = (uint64_t*)page_mem(table, create) + ((vaddr >> (PGSHIFT + 9 * level)) & 511);
+    reg_t entry = from_le(*pte);
+    if (!(entry & PTE_V)) {
+      if (!create)
+        return NULL;
+      reg_t paddr = alloc_page();
+      if (!paddr)
+        return NULL;
+      entry = (paddr >> PGSHIFT) << PTE_PPN_SHIFT | PTE_V;
+      *pte = to_le(entry);
+    }
+    table = (entry >> PTE_PPN_SHIFT) << PGSHIFT;
+  }
+  return (uint64_t*)page_mem(table, create) + ((vaddr >> PGSHIFT) & 511);
+}
+
+bool linux_user_t::map(reg_t vaddr, reg_t len, int prot)
+{
+  if (vaddr + len > USER_TOP || vaddr + len < vaddr)
+    return false;
+
+  // Pages that are already mapped keep their contents and gain prot.
+  for (reg_t va = vaddr; va < vaddr + len; va += PGSIZE) {
+    uint64_t* pte = walk(va, true);
+    if (!pte)
+      return false;
+    reg_t entry = from_le(*pte);
+    if (!(entry & PTE_ALLOCATED)) {
+      reg_t paddr = alloc_page();
+      if (!paddr)
+        return false;
+      entry = (paddr >> PGSHIFT) << PTE_PPN_SHIFT;
+    }
+    *pte = to_le(entry | pte_bits(prot));
+  }
+
+  flush_tlbs();
+  return true;
+}
+
+void linux_user_t::unmap(reg_t vaddr, reg_t len)
+{
+  for (reg_t va = vaddr; va < vaddr + len && va < USER_TOP; va += PGSIZE) {
+    uint64_t* pte = walk(va, false);
+    if (pte && (from_le(*pte) & PTE_ALLOCATED)) {
+      free_pages.push_back((from_le(*pte) >> PTE_PPN_SHIFT) << PGSHIFT);
+      *pte = 0;
+    }
+  }
+
+  flush_tlbs();
+}
+
+void linux_user_t::protect(reg_t vaddr, reg_t len, int prot)
+{
+  for (reg_t va = vaddr; va < vaddr + len && va < USER_TOP; va += PGSIZE) {
+    uint64_t* pte = walk(va, false);
+    if (pte && (from_le(*pte) & PTE_ALLOCATED)) {
+      reg_t entry = from_le(*pte) & ~reg_t(PTE_V | PTE_R | PTE_W | PTE_X);
+      *pte = to_le(entry | pte_bits(prot));
+    }
+  }
+
+  flush_tlbs();
+}
+
+// Find room for len bytes in the mmap area: the highest hole that fits, as
+// Linux's top-down allocator would choose, or else below mmap_next.
+reg_t linux_user_t::alloc_va(reg_t len)
+{
+  for (auto it = mmap_holes.rbegin(); it != mmap_holes.rend(); ++it) {
+    if (it->second - it->first >= len) {
+      reg_t vaddr = it->second - len;
+      if (vaddr == it->first)
+        mmap_holes.erase(it->first);
+      else
+        it->second = vaddr;
+      return vaddr;
+    }
+  }
+
+  if (len > mmap_next - page_round_up(brk_cur))
+    return 0;
+  mmap_next -= len;
+  return mmap_next;
+}
+
+// Take [vaddr, vaddr+len) out of the holes, for a fixed mapping.
+void linux_user_t::claim_va(reg_t vaddr, reg_t len)
+{
+  reg_t end = vaddr + len;
+  auto it = mmap_holes.upper_bound(vaddr);
+  if (it != mmap_holes.begin() && std::prev(it)->second > vaddr)
+    --it;
+  while (it != mmap_holes.end() && it->first < end) {
+    reg_t base = it->first, hole_end = it->second;
+    it = mmap_holes.erase(it);
+    if (base < vaddr)
+      mmap_holes[base] = vaddr;
+    if (hole_end > end)
+      mmap_holes[end] = hole_end;
+  }
+}
+
+// Return the part of [vaddr, vaddr+len) in the mmap area to the holes,
+// merging it with its neighbours, and with mmap_next if they meet.
+void linux_user_t::release_va(reg_t vaddr, reg_t len)
+{
+  reg_t base = std::max(vaddr, mmap_next), end = std::min(vaddr + len, MMAP_TOP);
+  if (base >= end)
+    return;
+
+  auto it = mmap_holes.upper_bound(base);
+  if (it != mmap_holes.begin() && std::prev(it)->second >= base)
+    --it;
+  while (it != mmap_holes.end() && it->first <= end) {
+    base = std::min(base, it->first);
+    end = std::max(end, it->second);
+    it = mmap_holes.erase(it);
+  }
+
+  if (base == mmap_next)
+    mmap_next = end;
+  else
+    mmap_holes[base] = end;
+}
+
+char* linux_user_t::user_mem(reg_t vaddr, bool write, bool check_perm)
+{
+  if (vaddr >= USER_TOP)
+    return NULL;
+
+  uint64_t* pte = walk(vaddr, false);
+  if (!pte)
+    return NULL;
+
+  reg_t entry = from_le(*pte);
+  if (!(entry & PTE_ALLOCATED))
+    return NULL;
+  if (check_perm && (!(entry & PTE_V) || !(entry & (write ? PTE_W : PTE_R))))
+    return NULL;
+
+  return page_mem((entry >> PTE_PPN_SHIFT) << PGSHIFT, write) + vaddr % PGSIZE;
+}
+
+bool linux_user_t::user_iov(reg_t vaddr, reg_t len, bool write, std::vector<struct iovec>* iov)
+{
+  iov->clear();
+  for (reg_t pos = 0, n; pos < len; pos += n) {
+    n = std::min(len - pos, PGSIZE - (vaddr + pos) % PGSIZE);
+    char* p = user_mem(vaddr + pos, write);
+    if (!p)
+      return false;
+
+    if (!iov->empty() && (char*)iov->back().iov_base + iov->back().iov_len == p)
+      iov->back().iov_len += n;
+    else
+      iov->push_back({p, size_t(n)});
+  }
+  return true;
+}
+
+bool linux_user_t::copy_in(void* dst, reg_t vaddr, size_t len)
+{
+  for (reg_t pos = 0, n; pos < len; pos += n) {
+    n = std::min(len - pos, PGSIZE - (vaddr + pos) % PGSIZE);
+    char* p = user_mem(vaddr + pos, false);
+    if (!p)
+      return false;
+    memcpy((char*)dst + pos, p, n);
+  }
+  return true;
+}
+
+bool linux_user_t::copy_out(reg_t vaddr, const void* src, size_t len, bool check_perm)
+{
+  for (reg_t pos = 0, n; pos < len; pos += n) {
+    n = std::min(len - pos, PGSIZE - (vaddr + pos) % PGSIZE);
+    char* p = user_mem(vaddr + pos, true, check_perm);
+    if (!p)
+      return false;
+    memcpy(p, (const char*)src + pos, n);
+  }
+  return true;
+}
+
+bool linux_user_t::read_string(reg_t vaddr, std::string* str)
+{
+  str->clear();
+  while (str->size() < PATH_MAX) {
+    const char* p = user_mem(vaddr, false);
+    if (!p)
+      return false;
+    size_t n = PGSIZE - vaddr % PGSIZE;
+    const char* nul = (const char*)memchr(p, 0, n);
+    if (nul) {
+      str->append(p, nul - p);
+      return true;
+    }
+    str->append(p, n);
+    vaddr += n;
+  }
+  return false;
+}
+
+void linux_user_t::load_elf(const std::string& path, bool interp, elf_info_t* info)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    fprintf(stderr, "couldn't open %s\n", path.c_str());
+    ::exit(-1);
+  }
+
+  size_t size = st.st_size;
+  void* file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    fprintf(stderr, "couldn't map %s\n", path.c_str());
+    ::exit(-1);
+  }
+
+  const char* buf = (const char*)file;
+  const Elf64_Ehdr* eh = (const Elf64_Ehdr*)buf;
+  if (size < sizeof(*eh) || !IS_ELF64(*eh) || !IS_ELFLE(*eh) || !IS_ELF_RISCV(*eh) ||
+      (eh->e_type != ET_EXEC && eh->e_type != ET_DYN) ||
+      eh->e_phoff + eh->e_phnum * sizeof(Elf64_Phdr) > size) {
+    fprintf(stderr, "%s is not a little-endian RV64 executable\n", path.c_str());
+    ::exit(-1);
+  }
+
+  // Position-independent executables go at ET_DYN_BASE, and interpreters
+  // below the mmap area, as Linux would place them.
+  const Elf64_Phdr* ph = (const Elf64_Phdr*)(buf + eh->e_phoff);
+  reg_t bias = 0;
+  if (eh->e_type == ET_DYN && !interp) {
+    bias = ET_DYN_BASE;
+  } else if (eh->e_type == ET_DYN) {
+    reg_t span = 0;
+    for (unsigned i = 0; i < eh->e_phnum; i++)
+      if (ph[i].p_type == PT_LOAD)
+        span = std::max(span, page_round_up(ph[i].p_vaddr + ph[i].p_memsz));
+    if (span > mmap_next - page_round_up(brk_cur)) {
+      fprintf(stderr, "%s is too large to load\n", path.c_str());
+      ::exit(-1);
+    }
+    bias = mmap_next - span;
+    mmap_next = bias;
+  }
+
+  info->base = bias;
+  info->entry = bias + eh->e_entry;
+  info->phdr = 0;
+  info->phnum = eh->e_phnum;
+  info->end = 0;
+  info->interp.clear();
+  for (unsigned i = 0; i < eh->e_phnum; i++) {
+    if (ph[i].p_type == PT_INTERP) {
+      if (interp || ph[i].p_offset + ph[i].p_filesz > size) {
+        fprintf(stderr, "%s has a bad program interpreter\n", path.c_str());
+        ::exit(-1);
+      }
+      info->interp.assign(buf + ph[i].p_offset, strnlen(buf + ph[i].p_offset, ph[i].p_filesz));
+    }
+    if (ph[i].p_type != PT_LOAD)
+      continue;
+
+    reg_t start = bias + ph[i].p_vaddr;
+    reg_t seg_end = start + ph[i].p_memsz;
+    int prot = ((ph[i].p_flags & PF_R) ? TARGET_PROT_READ : 0) |
+               ((ph[i].p_flags & PF_W) ? TARGET_PROT_WRITE : 0) |
+               ((ph[i].p_flags & PF_X) ? TARGET_PROT_EXEC : 0);
+    reg_t page = start & ~reg_t(PGSIZE - 1);
+    if (ph[i].p_offset + ph[i].p_filesz > size ||
+        !map(page, page_round_up(seg_end) - page, prot) ||
+        !copy_out(start, buf + ph[i].p_offset, ph[i].p_filesz, false)) {
+      fprintf(stderr, "couldn't load segment %u of %s\n", i, path.c_str());
+      ::exit(-1);
+    }
+
+    if (eh->e_phoff >= ph[i].p_offset && eh->e_phoff < ph[i].p_offset + ph[i].p_filesz)
+      info->phdr = start + eh->e_phoff - ph[i].p_offset;
+    info->end = std::max(info->end, seg_end);
+  }
+  munmap(file, size);
+}
+
+void linux_user_t::load(const std::vector<std::string>& args)
+{
+  processor_t* proc = procs[0];
+  if (proc->get_xlen() != 64 || !proc->extension_enabled('S')) {
+    fprintf(stderr, "--linux-user requires RV64 harts that implement S-mode\n");
+    ::exit(-1);
+  }
+
+  exe_path = args[0];
+  elf_info_t exe, interp;
+  load_elf(exe_path, false, &exe);
+  brk_start = brk_cur = page_round_up(exe.end);
+
+  // A dynamically linked program starts in its interpreter, which finds
+  // the program through the auxiliary vector.
+  reg_t entry = exe.entry, base = 0;
+  if (!exe.interp.empty()) {
+    load_elf(exe.interp, true, &interp);
+    entry = interp.entry;
+    base = interp.base;
+  }
+
+  // Build the initial stack: strings at the top, then the auxiliary vector,
+  // environment and argument pointers, and argc at the stack pointer.
+  if (!map(USER_TOP - STACK_SIZE, STACK_SIZE, TARGET_PROT_READ | TARGET_PROT_WRITE)) {
+    fprintf(stderr, "couldn't allocate the target stack\n");
+    ::exit(-1);
+  }
+
+  reg_t sp = USER_TOP;
+  auto push = [&](const void* data, size_t len) {
+    sp -= len;
+    copy_out(sp, data, len);
+    return sp;
+  };
+
+  uint8_t random[16] = {0};
+  int rfd = open("/dev/urandom", O_RDONLY);
+  if (rfd >= 0) {
+    if (read(rfd, random, sizeof(random)) < 0)
+      memset(random, 0, sizeof(random));
+    close(rfd);
+  }
+  reg_t random_addr = push(random, sizeof(random));
+
+  std::vector<reg_t> argv, envp;
+  for (auto& arg : args)
+    argv.push_back(push(arg.c_str(), arg.size() + 1));
+  for (char** env = environ; *env; env++)
+    envp.push_back(push(*env, strlen(*env) + 1));
+
+  reg_t hwcap = 0;
+  for (const char* ext = "IMAFDCV"; *ext; ext++)
+    if (proc->extension_enabled(*ext))
+      hwcap |= reg_t(1) << (*ext - 'A');
+
+  std::vector<reg_t> words;
+  words.push_back(argv.size());
+  words.insert(words.end(), argv.begin(), argv.end());
+  words.push_back(0);
+  words.insert(words.end(), envp.begin(), envp.end());
+  words.push_back(0);
+  reg_t auxv[][2] = {
+    {AT_PHDR, exe.phdr},
+    {AT_PHENT, sizeof(Elf64_Phdr)},
+    {AT_PHNUM, exe.phnum},
+    {AT_PAGESZ, PGSIZE},
+    {AT_BASE, base},
+    {AT_FLAGS, 0},
+    {AT_ENTRY, exe.entry},
+    {AT_UID, reg_t(getuid())},
+    {AT_EUID, reg_t(geteuid())},
+    {AT_GID, reg_t(getgid())},
+    {AT_EGID, reg_t(getegid())},
+    {AT_HWCAP, hwcap},
+    {AT_CLKTCK, 100},
+    {AT_SECURE, 0},
+    {AT_RANDOM, random_addr},
+    {AT_EXECFN, argv[0]},
+    {AT_NULL, 0},
+  };
+  for (auto& aux : auxv) {
+    words.push_back(aux[0]);
+    words.push_back(aux[1]);
+  }
+
+  sp = (sp - words.size() * sizeof(reg_t)) & ~reg_t(15);
+  for (size_t i = 0; i < words.size(); i++) {
+    uint64_t word = to_le(words[i]);
+    copy_out(sp + i * sizeof(reg_t), &word, sizeof(word));
+  }
+
+  // Every hart gets the same address space; all but the first wait for a
+  // thread to run.
+  for (processor_t* p : procs) {
+    enter_user(p);
+    p->set_waiting(p != proc);
+  }
+  threads[0].tid = next_tid++;
+  proc->get_state()->XPR.write(2, sp);
+  proc->get_state()->pc = entry;
+}
+
+void linux_user_t::enter_user(processor_t* proc)
+{
+  // Give U-mode access to all of physical memory, the FPU and vector unit,
+  // and the counters, then drop to U-mode with paging enabled.
+  state_t* state = proc->get_state();
+  if (proc->n_pmp) {
+    proc->put_csr(CSR_PMPADDR0, ~reg_t(0));
+    proc->put_csr(CSR_PMPCFG0, PMP_NAPOT | PMP_R | PMP_W | PMP_X);
+  }
+  reg_t mstatus = state->mstatus->read();
+  if (proc->extension_enabled('F'))
+    mstatus = set_field(mstatus, MSTATUS_FS, 1);
+  if (proc->extension_enabled('V'))
+    mstatus = set_field(mstatus, MSTATUS_VS, 1);
+  proc->put_csr(CSR_MSTATUS, mstatus);
+  proc->put_csr(CSR_MCOUNTEREN, ~reg_t(0));
+  proc->put_csr(CSR_SCOUNTEREN, ~reg_t(0));
+  proc->put_csr(CSR_SATP, set_field(reg_t(0), SATP64_MODE, SATP_MODE_SV39) | (root_table >> PGSHIFT));
+  proc->set_privilege(PRV_U);
+}
+
+bool linux_user_t::handle_trap(processor_t* proc, trap_t& t, reg_t epc)
+{
+  if (t.cause() >> (proc->get_xlen() - 1))
+    return false;
+
+  // Once the program has exited, keep the harts parked on the trapping
+  // instruction until the simulation stops.
+  state_t* state = proc->get_state();
+  state->pc = epc;
+  if (done)
+    return true;
+
+  if (t.cause() == CAUSE_USER_ECALL) {
+    size_t hart = std::find(procs.begin(), procs.end(), proc) - procs.begin();
+    reg_t ret = syscall(hart, state->XPR[17], state->XPR[10], state->XPR[11], state->XPR[12],
+                        state->XPR[13], state->XPR[14], state->XPR[15]);
+    if (!done) {
+      state->XPR.write(10, ret);
+      state->pc = epc + 4;
+    }
+    return true;
+  }
+
+  int sig;
+  switch (t.cause()) {
+    case CAUSE_ILLEGAL_INSTRUCTION: sig = SIGILL; break;
+    case CAUSE_BREAKPOINT: sig = SIGTRAP; break;
+    case CAUSE_MISALIGNED_FETCH:
+    case CAUSE_MISALIGNED_LOAD:
+    case CAUSE_MISALIGNED_STORE: sig = SIGBUS; break;
+    default: sig = SIGSEGV; break;
+  }
+
+  fprintf(stderr, "%s: %s at pc 0x%016" PRIx64 ", tval 0x%016" PRIx64 "\n",
+          exe_path.c_str(), t.name(), epc, t.get_tval());
+  terminate(128 + sig);
+  return true;
+}
+
+reg_t linux_user_t::syscall(size_t hart, reg_t n, reg_t a0, reg_t a1, reg_t a2, reg_t a3, reg_t a4, reg_t a5)
+{
+  std::string path;
+  switch (n) {
+    case TARGET_NR_read:
+      return sys_rw(a0, a1, a2, false, -1);
+    case TARGET_NR_write:
+      return sys_rw(a0, a1, a2, true, -1);
+    case TARGET_NR_pread64:
+      return sreg_t(a3) < 0 ? -EINVAL : sys_rw(a0, a1, a2, false, a3);
+    case TARGET_NR_pwrite64:
+      return sreg_t(a3) < 0 ? -EINVAL : sys_rw(a0, a1, a2, true, a3);
+    case TARGET_NR_readv:
+      return sys_rwv(a0, a1, a2, false);
+    case TARGET_NR_writev:
+      return sys_rwv(a0, a1, a2, true);
+    case TARGET_NR_openat:
+      if (!read_string(a1, &path))
+        return -EFAULT;
+      return install_fd(openat(host_dirfd(a0), path.c_str(), host_open_flags(a2), a3), 0);
+    case TARGET_NR_close:
+      if (host_fd(a0) < 0)
+        return -EBADF;
+      close(fds[a0]);
+      fds[a0] = -1;
+      return 0;
+    case TARGET_NR_lseek:
+      if (host_fd(a0) < 0)
+        return -EBADF;
+      return sysret_errno(lseek(host_fd(a0), a1, a2));
+    case TARGET_NR_dup:
+      return host_fd(a0) < 0 ? -EBADF : install_fd(dup(host_fd(a0)), 0);
+    case TARGET_NR_dup3:
+      return sys_dup3(a0, a1, a2);
+    case TARGET_NR_fcntl:
+      return sys_fcntl(a0, a1, a2);
+    case TARGET_NR_ioctl: {
+      if (a1 != TARGET_TIOCGWINSZ)
+        return -ENOTTY;
+      struct winsize ws;
+      if (ioctl(host_fd(a0), TIOCGWINSZ, &ws) < 0)
+        return -errno;
+      uint16_t out[4] = {to_le(uint16_t(ws.ws_row)), to_le(uint16_t(ws.ws_col)),
+                         to_le(uint16_t(ws.ws_xpixel)), to_le(uint16_t(ws.ws_ypixel))};
+      return copy_out(a2, out, sizeof(out)) ? 0 : -EFAULT;
+    }
+    case TARGET_NR_newfstatat:
+      return sys_stat(a0, a1, a2, a3);
+    case TARGET_NR_fstat:
+      return sys_stat(a0, 0, a1, 0);
+    case TARGET_NR_faccessat:
+      if (!read_string(a1, &path))
+        return -EFAULT;
+      return sysret_errno(faccessat(host_dirfd(a0), path.c_str(), a2, 0));
+    case TARGET_NR_unlinkat:
+      if (!read_string(a1, &path))
+        return -EFAULT;
+      return sysret_errno(unlinkat(host_dirfd(a0), path.c_str(), a2));
+    case TARGET_NR_mkdirat:
+      if (!read_string(a1, &path))
+        return -EFAULT;
+      return sysret_errno(mkdirat(host_dirfd(a0), path.c_str(), a2));
+    case TARGET_NR_readlinkat: {
+      if (!read_string(a1, &path))
+        return -EFAULT;
+      char buf[PATH_MAX];
+      ssize_t len;
+      if (path == "/proc/self/exe") {
+        if (!realpath(exe_path.c_str(), buf))
+          return -errno;
+        len = strlen(buf);
+      } else if ((len = readlinkat(host_dirfd(a0), path.c_str(), buf, sizeof(buf))) < 0) {
+        return -errno;
+      }
+      len = std::min(size_t(len), size_t(a3));
+      return copy_out(a2, buf, len) ? len : -EFAULT;
+    }
+    case TARGET_NR_getcwd: {
+      char buf[PATH_MAX];
+      if (!getcwd(buf, sizeof(buf)))
+        return -errno;
+      size_t len = strlen(buf) + 1;
+      if (len > a1)
+        return -ERANGE;
+      return copy_out(a0, buf, len) ? len : -EFAULT;
+    }
+    case TARGET_NR_exit:
+      exit_thread(hart, a0 & 0xff);
+      return 0;
+    case TARGET_NR_exit_group:
+      terminate(a0 & 0xff);
+      return 0;
+    case TARGET_NR_set_tid_address:
+      threads[hart].clear_child_tid = a0;
+      return threads[hart].tid;
+    case TARGET_NR_gettid:
+      return threads[hart].tid;
+    case TARGET_NR_getpid:
+      return getpid();
+    case TARGET_NR_getppid:
+      return getppid();
+    case TARGET_NR_getuid:
+      return getuid();
+    case TARGET_NR_geteuid:
+      return geteuid();
+    case TARGET_NR_getgid:
+      return getgid();
+    case TARGET_NR_getegid:
+      return getegid();
+    case TARGET_NR_set_robust_list:
+    case TARGET_NR_sched_yield:
+    case TARGET_NR_madvise:
+      return 0;
+    case TARGET_NR_rt_sigaction: {
+      // Signals are never delivered, so report every action as the default.
+      static const uint8_t zero[24] = {0};
+      return !a2 || copy_out(a2, zero, sizeof(zero)) ? 0 : -EFAULT;
+    }
+    case TARGET_NR_rt_sigprocmask: {
+      static const uint8_t zero[128] = {0};
+      if (a3 > sizeof(zero))
+        return -EINVAL;
+      return !a2 || copy_out(a2, zero, a3) ? 0 : -EFAULT;
+    }
+    case TARGET_NR_clock_gettime: {
+      struct timespec ts;
+      if (clock_gettime(a0, &ts) < 0)
+        return -errno;
+      int64_t out[2] = {to_le(int64_t(ts.tv_sec)), to_le(int64_t(ts.tv_nsec))};
+      return copy_out(a1, out, sizeof(out)) ? 0 : -EFAULT;
+    }
+    case TARGET_NR_gettimeofday: {
+      struct timeval tv;
+      gettimeofday(&tv, NULL);
+      int64_t out[2] = {to_le(int64_t(tv.tv_sec)), to_le(int64_t(tv.tv_usec))};
+      return !a0 || copy_out(a0, out, sizeof(out)) ? 0 : -EFAULT;
+    }
+    case TARGET_NR_uname:
+      return sys_uname(a0);
+    case TARGET_NR_brk:
+      return sys_brk(a0);
+    case TARGET_NR_mmap:
+      return sys_mmap(a0, a1, a2, a3, a4, a5);
+    case TARGET_NR_clone:
+      return sys_clone(hart, a0, a1, a2, a3, a4);
+    case TARGET_NR_futex:
+      return sys_futex(hart, a0, a1, a2, a3, a4, a5);
+    case TARGET_NR_munmap:
+      if (a0 % PGSIZE)
+        return -EINVAL;
+      unmap(a0, page_round_up(a1));
+      release_va(a0, page_round_up(a1));
+      return 0;
+    case TARGET_NR_mremap:
+      // Callers fall back to allocating a new mapping and copying.
+      return -ENOMEM;
+    case TARGET_NR_mprotect:
+      if (a0 % PGSIZE)
+        return -EINVAL;
+      protect(a0, page_round_up(a1), a2);
+      return 0;
+    case TARGET_NR_prlimit64: {
+      if (!a3)
+        return 0;
+      struct rlimit rl;
+      if (getrlimit(a1, &rl) < 0)
+        return -errno;
+      uint64_t out[2] = {to_le(uint64_t(rl.rlim_cur)), to_le(uint64_t(rl.rlim_max))};
+      if (a1 == TARGET_RLIMIT_STACK)
+        out[0] = to_le(uint64_t(STACK_SIZE));
+      return copy_out(a3, out, sizeof(out)) ? 0 : -EFAULT;
+    }
+    case TARGET_NR_getrandom: {
+      std::vector<struct iovec> iov;
+      if (!user_iov(a0, a1, true, &iov))
+        return -EFAULT;
+      int fd = open("/dev/urandom", O_RDONLY);
+      if (fd < 0)
+        return -errno;
+      reg_t ret = host_rwv(fd, iov, false, -1);
+      close(fd);
+      return ret;
+    }
+    default:
+      return -ENOSYS;
+  }
+}
+
+reg_t linux_user_t::sys_rw(reg_t fd, reg_t vaddr, reg_t len, bool write, off_t off)
+{
+  if (host_fd(fd) < 0)
+    return -EBADF;
+  std::vector<struct iovec> iov;
+  if (!user_iov(vaddr, len, !write, &iov))
+    return -EFAULT;
+  return host_rwv(host_fd(fd), iov, write, off);
+}
+
+reg_t linux_user_t::sys_rwv(reg_t fd, reg_t viov, reg_t cnt, bool write)
+{
+  if (host_fd(fd) < 0)
+    return -EBADF;
+  if (cnt > IOV_MAX)
+    return -EINVAL;
+
+  std::vector<struct iovec> iov, piece;
+  for (reg_t i = 0; i < cnt; i++) {
+    uint64_t desc[2];
+    if (!copy_in(desc, viov + i * sizeof(desc), sizeof(desc)) ||
+        !user_iov(from_le(desc[0]), from_le(desc[1]), !write, &piece))
+      return -EFAULT;
+    iov.insert(iov.end(), piece.begin(), piece.end());
+  }
+  return host_rwv(host_fd(fd), iov, write, -1);
+}
+
+reg_t linux_user_t::sys_stat(reg_t dirfd, reg_t vpath, reg_t vbuf, int flags)
+{
+  struct stat st;
+  if (vpath) {
+    std::string path;
+    if (!read_string(vpath, &path))
+      return -EFAULT;
+    if (fstatat(host_dirfd(dirfd), path.c_str(), &st, flags) < 0)
+      return -errno;
+  } else if (fstat(host_fd(dirfd), &st) < 0) {
+    return -errno;
+  }
+
+  target_stat ts = {};
+  ts.dev = to_le(uint64_t(st.st_dev));
+  ts.ino = to_le(uint64_t(st.st_ino));
+  ts.mode = to_le(uint32_t(st.st_mode));
+  ts.nlink = to_le(uint32_t(st.st_nlink));
+  ts.uid = to_le(uint32_t(st.st_uid));
+  ts.gid = to_le(uint32_t(st.st_gid));
+  ts.rdev = to_le(uint64_t(st.st_rdev));
+  ts.size = to_le(int64_t(st.st_size));
+  ts.blksize = to_le(int32_t(st.st_blksize));
+  ts.blocks = to_le(int64_t(st.st_blocks));
+  ts.atime = to_le(int64_t(st.st_atime));
+  ts.mtime = to_le(int64_t(st.st_mtime));
+  ts.ctime = to_le(int64_t(st.st_ctime));
+  return copy_out(vbuf, &ts, sizeof(ts)) ? 0 : -EFAULT;
+}
+
+reg_t linux_user_t::sys_dup3(reg_t oldfd, reg_t newfd, reg_t flags)
+{
+  if (flags & ~reg_t(TARGET_O_CLOEXEC))
+    return -EINVAL;
+  int hfd = host_fd(oldfd);
+  if (hfd < 0)
+    return -EBADF;
+  if (oldfd == newfd)
+    return -EINVAL;
+
+  int host_flags = (flags & TARGET_O_CLOEXEC) ? O_CLOEXEC : 0;
+  if (host_fd(newfd) >= 0)
+    return dup3(hfd, fds[newfd], host_flags) < 0 ? -errno : newfd;
+
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && newfd >= rl.rlim_cur)
+    return -EBADF;
+  int dupfd = fcntl(hfd, host_flags ? F_DUPFD_CLOEXEC : F_DUPFD, 0);
+  if (dupfd < 0)
+    return -errno;
+  if (newfd >= fds.size())
+    fds.resize(newfd + 1, -1);
+  fds[newfd] = dupfd;
+  return newfd;
+}
+
+reg_t linux_user_t::sys_fcntl(reg_t fd, reg_t cmd, reg_t arg)
+{
+  int hfd = host_fd(fd), ret;
+  if (hfd < 0)
+    return -EBADF;
+
+  switch (cmd) {
+    case TARGET_F_DUPFD:
+    case TARGET_F_DUPFD_CLOEXEC:
+      return install_fd(fcntl(hfd, cmd == TARGET_F_DUPFD ? F_DUPFD : F_DUPFD_CLOEXEC, 0), arg);
+    case TARGET_F_GETFD:
+      if ((ret = fcntl(hfd, F_GETFD)) < 0)
+        return -errno;
+      return (ret & FD_CLOEXEC) ? TARGET_FD_CLOEXEC : 0;
+    case TARGET_F_SETFD:
+      return sysret_errno(fcntl(hfd, F_SETFD, (arg & TARGET_FD_CLOEXEC) ? FD_CLOEXEC : 0));
+    case TARGET_F_GETFL:
+      if ((ret = fcntl(hfd, F_GETFL)) < 0)
+        return -errno;
+      return target_open_flags(ret);
+    case TARGET_F_SETFL:
+      return sysret_errno(fcntl(hfd, F_SETFL, host_open_flags(arg)));
+    default:
+      // Only the commands that take an integer argument are supported.
+      return -EINVAL;
+  }
+}
+
+// Only threads are supported: a new process would need an address space,
+// and a simulator, of its own.
+reg_t linux_user_t::sys_clone(size_t hart, reg_t flags, reg_t sp, reg_t ptid, reg_t tls, reg_t ctid)
+{
+  if ((flags & (TARGET_CLONE_VM | TARGET_CLONE_THREAD)) != (TARGET_CLONE_VM | TARGET_CLONE_THREAD))
+    return -ENOSYS;
+
+  size_t child = 0;
+  while (child < threads.size() && threads[child].tid)
+    child++;
+  if (child == threads.size())
+    return -EAGAIN;
+
+  reg_t tid = next_tid;
+  uint32_t tid_le = to_le(uint32_t(tid));
+  if (((flags & TARGET_CLONE_PARENT_SETTID) && !copy_out(ptid, &tid_le, sizeof(tid_le))) ||
+      ((flags & TARGET_CLONE_CHILD_SETTID) && !copy_out(ctid, &tid_le, sizeof(tid_le))))
+    return -EFAULT;
+  next_tid++;
+
+  // The child resumes after the ecall with the parent's registers, apart
+  // from its return value, stack and thread pointer.
+  state_t* parent = procs[hart]->get_state();
+  state_t* state = procs[child]->get_state();
+  for (int i = 0; i < NXPR; i++)
+    state->XPR.write(i, parent->XPR[i]);
+  for (int i = 0; i < NFPR; i++)
+    state->FPR.write(i, parent->FPR[i]);
+  state->frm->write(parent->frm->read());
+  state->fflags->write(parent->fflags->read());
+  state->XPR.write(10, 0);
+  if (sp)
+    state->XPR.write(2, sp);
+  if (flags & TARGET_CLONE_SETTLS)
+    state->XPR.write(4, tls);
+  state->pc = parent->pc + 4;
+
+  threads[child].tid = tid;
+  threads[child].clear_child_tid = (flags & TARGET_CLONE_CHILD_CLEARTID) ? ctid : 0;
+  procs[child]->set_waiting(false);
+  return tid;
+}
+
+reg_t linux_user_t::sys_futex(size_t hart, reg_t uaddr, reg_t op, reg_t val, reg_t timeout,
+                              reg_t uaddr2, reg_t val3)
+{
+  // Every futex belongs to this one process, so private ones are no different.
+  int cmd = op & ~reg_t(TARGET_FUTEX_PRIVATE_FLAG | TARGET_FUTEX_CLOCK_REALTIME);
+  uint32_t bitset = ~uint32_t(0), cur;
+  switch (cmd) {
+    case TARGET_FUTEX_WAIT_BITSET:
+      bitset = val3;
+      // Fall through.
+    case TARGET_FUTEX_WAIT: {
+      if (uaddr % sizeof(cur) || !bitset)
+        return -EINVAL;
+      if (!copy_in(&cur, uaddr, sizeof(cur)))
+        return -EFAULT;
+      if (from_le(cur) != uint32_t(val))
+        return -EAGAIN;
+
+      // FUTEX_WAIT's timeout is relative, on the monotonic clock, and
+      // FUTEX_WAIT_BITSET's an absolute time on the clock the op names.
+      thread_t& t = threads[hart];
+      t.futex_timed = timeout != 0;
+      if (timeout) {
+        int64_t ts[2];
+        if (!copy_in(ts, timeout, sizeof(ts)))
+          return -EFAULT;
+        int64_t sec = from_le(ts[0]), nsec = from_le(ts[1]);
+        if (sec < 0 || nsec < 0 || nsec >= 1000000000)
+          return -EINVAL;
+        t.futex_clock = cmd == TARGET_FUTEX_WAIT_BITSET && (op & TARGET_FUTEX_CLOCK_REALTIME)
+                        ? CLOCK_REALTIME : CLOCK_MONOTONIC;
+        t.futex_deadline.tv_sec = sec;
+        t.futex_deadline.tv_nsec = nsec;
+        if (cmd == TARGET_FUTEX_WAIT) {
+          struct timespec now;
+          clock_gettime(t.futex_clock, &now);
+          t.futex_deadline.tv_sec += now.tv_sec;
+          t.futex_deadline.tv_nsec += now.tv_nsec;
+          if (t.futex_deadline.tv_nsec >= 1000000000) {
+            t.futex_deadline.tv_sec++;
+            t.futex_deadline.tv_nsec -= 1000000000;
+          }
+        }
+        if (ns_until(t.futex_clock, t.futex_deadline) == 0)
+          return -ETIMEDOUT;
+      }
+
+      // tick() ends a timed wait, by writing -ETIMEDOUT over this return.
+      t.futex = uaddr;
+      t.futex_bitset = bitset;
+      procs[hart]->set_waiting(true);
+      check_deadlock();
+      return 0;
+    }
+    case TARGET_FUTEX_WAKE_BITSET:
+      if (!val3)
+        return -EINVAL;
+      bitset = val3;
+      // Fall through.
+    case TARGET_FUTEX_WAKE:
+      return futex_wake(uaddr, std::min(val, reg_t(INT_MAX)), bitset);
+    case TARGET_FUTEX_CMP_REQUEUE:
+      if (!copy_in(&cur, uaddr, sizeof(cur)))
+        return -EFAULT;
+      if (from_le(cur) != uint32_t(val3))
+        return -EAGAIN;
+      // Fall through.
+    case TARGET_FUTEX_REQUEUE: {
+      if (uaddr2 % sizeof(cur) || !copy_in(&cur, uaddr2, sizeof(cur)))
+        return -EFAULT;
+      // The timeout argument carries the most waiters to requeue.
+      size_t moved = futex_wake(uaddr, std::min(val, reg_t(INT_MAX)), bitset);
+      for (size_t i = 0, requeued = 0; i < threads.size() && requeued < timeout; i++) {
+        if (threads[i].futex && threads[i].futex == uaddr) {
+          threads[i].futex = uaddr2;
+          requeued++;
+          moved++;
+        }
+      }
+      return moved;
+    }
+    default:
+      return -ENOSYS;
+  }
+}
+
+reg_t linux_user_t::sys_uname(reg_t vbuf)
+{
+  char uts[6][65] = {"Linux", "spike", "6.1.0", "#1", "riscv64", ""};
+  return copy_out(vbuf, uts, sizeof(uts)) ? 0 : -EFAULT;
+}
+
+reg_t linux_user_t::sys_brk(reg_t addr)
+{
+  reg_t old_end = page_round_up(brk_cur), new_end = page_round_up(addr);
+  if (addr < brk_start || new_end > mmap_next)
+    return brk_cur;
+
+  if (new_end > old_end && !map(old_end, new_end - old_end, TARGET_PROT_READ | TARGET_PROT_WRITE))
+    return brk_cur;
+  if (new_end < old_end)
+    unmap(new_end, old_end - new_end);
+
+  brk_cur = addr;
+  return brk_cur;
+}
+
+reg_t linux_user_t::sys_mmap(reg_t addr, reg_t len, reg_t prot, reg_t flags, reg_t fd, reg_t off)
+{
+  if (len == 0 || off % PGSIZE)
+    return -EINVAL;
+
+  int hfd = -1;
+  if (!(flags & TARGET_MAP_ANONYMOUS) && (hfd = host_fd(fd)) < 0)
+    return -EBADF;
+
+  len = page_round_up(len);
+  reg_t vaddr;
+  if (flags & TARGET_MAP_FIXED) {
+    if (addr % PGSIZE || addr + len > USER_TOP || addr + len < addr)
+      return -EINVAL;
+    vaddr = addr;
+    unmap(vaddr, len);
+    claim_va(vaddr, len);
+  } else if (!(vaddr = alloc_va(len))) {
+    return -ENOMEM;
+  }
+
+  if (!map(vaddr, len, prot)) {
+    unmap(vaddr, len);
+    release_va(vaddr, len);
+    return -ENOMEM;
+  }
+
+  // File mappings are private copies; shared mappings are not supported.
+  if (!(flags & TARGET_MAP_ANONYMOUS)) {
+    for (reg_t pos = 0; pos < len; pos += PGSIZE) {
+      ssize_t ret = pread(hfd, user_mem(vaddr + pos, true, false), PGSIZE, off + pos);
+      if (ret < 0) {
+        int err = errno;
+        unmap(vaddr, len);
+        release_va(vaddr, len);
+        return -err;
+      }
+      if (ret < (ssize_t)PGSIZE)
+        break;
+    }
+  }
+
+  return vaddr;
+}
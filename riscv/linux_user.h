@@ -0,0 +1,137 @@
+// See LICENSE for license details.
+
+#ifndef _RISCV_LINUX_USER_H
+#define _RISCV_LINUX_USER_H
+
+#include "decode.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+class processor_t;
+class simif_t;
+class trap_t;
+
+// Runs an RV64 Linux executable directly in U-mode, with the simulator
+// standing in for the kernel: it builds Sv39 page tables in target memory
+// and services environment calls with host system calls. Each thread of the
+// program runs on a hart of its own; harts without a thread are parked.
+class linux_user_t
+{
+ public:
+  // Page tables and user pages are allocated from [mem_base, mem_base+size).
+  linux_user_t(simif_t* sim, const std::vector<processor_t*>& procs,
+               reg_t mem_base, reg_t mem_size);
+  ~linux_user_t();
+
+  // Map the executable args[0] and its program interpreter, if it names
+  // one, build the initial stack with args as argv, and point the first
+  // hart at the entry point in U-mode.
+  void load(const std::vector<std::string>& args);
+
+  // Handle a trap taken from U-mode by proc. Returns false if it should
+  // instead be delivered to the target as usual.
+  bool handle_trap(processor_t* proc, trap_t& t, reg_t epc);
+
+  // Called once per round of quanta. Wakes threads whose futex waits have
+  // timed out, and sleeps on the host while every thread is waiting for one.
+  void tick();
+
+  bool exited() const { return done; }
+  int exit_status() const { return status; }
+
+ private:
+  simif_t* sim;
+  std::vector<processor_t*> procs;
+  reg_t mem_next;
+  reg_t mem_end;
+  std::vector<reg_t> free_pages;
+  reg_t root_table;
+  std::string exe_path;
+
+  reg_t brk_start;
+  reg_t brk_cur;
+  reg_t mmap_next;
+  // Unmapped ranges of the mmap area above mmap_next, base to end.
+  std::map<reg_t, reg_t> mmap_holes;
+
+  bool done;
+  int status;
+
+  // The thread running on each hart; tid is 0 if the hart is parked.
+  struct thread_t {
+    reg_t tid;
+    reg_t clear_child_tid;
+    // While blocked in FUTEX_WAIT, the futex address and wake bitset, and
+    // when the wait times out, if it does.
+    reg_t futex;
+    uint32_t futex_bitset;
+    bool futex_timed;
+    clockid_t futex_clock;
+    struct timespec futex_deadline;
+  };
+  std::vector<thread_t> threads;
+  reg_t next_tid;
+
+  // Target file descriptors index this table of host descriptors, which
+  // are the target's own, so that it cannot reach the simulator's files.
+  // Free slots hold -1.
+  std::vector<int> fds;
+
+  // What load_elf learned about an executable it mapped.
+  struct elf_info_t {
+    reg_t base;
+    reg_t entry;
+    reg_t phdr;
+    reg_t phnum;
+    reg_t end;
+    std::string interp;
+  };
+  void load_elf(const std::string& path, bool interp, elf_info_t* info);
+  void enter_user(processor_t* proc);
+
+  void terminate(int code);
+  void exit_thread(size_t hart, int code);
+  size_t futex_wake(reg_t uaddr, size_t count, uint32_t bitset);
+  void check_deadlock();
+  void flush_tlbs();
+
+  reg_t alloc_page();
+  char* page_mem(reg_t paddr, bool write);
+  uint64_t* walk(reg_t vaddr, bool create);
+  bool map(reg_t vaddr, reg_t len, int prot);
+  void unmap(reg_t vaddr, reg_t len);
+  void protect(reg_t vaddr, reg_t len, int prot);
+  reg_t alloc_va(reg_t len);
+  void claim_va(reg_t vaddr, reg_t len);
+  void release_va(reg_t vaddr, reg_t len);
+
+  // Accessors for target virtual memory; these fail if any page in the
+  // range is unmapped or lacks the required permission.
+  char* user_mem(reg_t vaddr, bool write, bool check_perm = true);
+  bool user_iov(reg_t vaddr, reg_t len, bool write, std::vector<struct iovec>* iov);
+  bool copy_in(void* dst, reg_t vaddr, size_t len);
+  bool copy_out(reg_t vaddr, const void* src, size_t len, bool check_perm = true);
+  bool read_string(reg_t vaddr, std::string* str);
+
+  int host_fd(reg_t fd);
+  int host_dirfd(reg_t dirfd);
+  reg_t install_fd(int hfd, reg_t min_fd);
+
+  reg_t syscall(size_t hart, reg_t n, reg_t a0, reg_t a1, reg_t a2, reg_t a3, reg_t a4, reg_t a5);
+  reg_t sys_mmap(reg_t addr, reg_t len, reg_t prot, reg_t flags, reg_t fd, reg_t off);
+  reg_t sys_brk(reg_t addr);
+  reg_t sys_rw(reg_t fd, reg_t vaddr, reg_t len, bool write, off_t off);
+  reg_t sys_rwv(reg_t fd, reg_t viov, reg_t cnt, bool write);
+  reg_t sys_stat(reg_t dirfd, reg_t vpath, reg_t vbuf, int flags);
+  reg_t sys_dup3(reg_t oldfd, reg_t newfd, reg_t flags);
+  reg_t sys_fcntl(reg_t fd, reg_t cmd, reg_t arg);
+  reg_t sys_clone(size_t hart, reg_t flags, reg_t sp, reg_t ptid, reg_t tls, reg_t ctid);
+  reg_t sys_futex(size_t hart, reg_t uaddr, reg_t op, reg_t val, reg_t timeout, reg_t uaddr2, reg_t val3);
+  reg_t sys_uname(reg_t vbuf);
+};
+
+#endif
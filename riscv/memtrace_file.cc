@@ -0,0 +1,96 @@
+// See LICENSE for license details.
+
+#include "memtrace_file.h"
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+#include <stdexcept>
+
+memtrace_file_t::memtrace_file_t(const char* path, bool fetches)
+  : fetches(fetches), instret_start(0), instret_end(UINT64_MAX),
+    pc_lo(0), pc_hi(UINT64_MAX), block(BLOCK_SIZE), block_len(0),
+    block_records(0), last_hart(0), last_pc(0), last_vaddr(0), last_offset(0)
+{
+  file = fopen(path, "wb");
+  if (!file) {
+    std::ostringstream oss;
+    oss << "Failed to open memory trace file at `" << path << "': "
+        << strerror(errno);
+    throw std::runtime_error(oss.str());
+  }
+  fwrite("SPKMTR01", 1, 8, file);
+}
+
+memtrace_file_t::~memtrace_file_t()
+{
+  flush_block();
+  fclose(file);
+}
+
+void memtrace_file_t::put_varint(uint64_t x)
+{
+  while (x >= 0x80) {
+    block[block_len++] = uint8_t(x) | 0x80;
+    x >>= 7;
+  }
+  block[block_len++] = uint8_t(x);
+}
+
+void memtrace_file_t::trace_record(const memtrace_record_t& r)
+{
+  if (r.pc < pc_lo || r.pc >= pc_hi || r.instret < instret_start || r.instret >= instret_end)
+    return;
+
+  if (block_len + MAX_RECORD_SIZE > block.size())
+    flush_block();
+
+  unsigned size_code = 7;
+  if (r.bytes && (r.bytes & (r.bytes - 1)) == 0 && r.bytes <= 64)
+    size_code = __builtin_ctzll(r.bytes);
+  uint64_t offset = r.paddr - r.vaddr;
+
+  uint8_t header = (r.type == LOAD ? 0 : r.type == STORE ? 1 : 2) | (size_code << 2);
+  if (r.hart != last_hart)
+    header |= 1 << 5;
+  if (r.pc != last_pc)
+    header |= 1 << 6;
+  if (offset != last_offset)
+    header |= 1 << 7;
+  block[block_len++] = header;
+
+  if (size_code == 7)
+    put_varint(r.bytes);
+  if (r.hart != last_hart)
+    put_varint(r.hart);
+  if (r.pc != last_pc)
+    put_zigzag(int64_t(r.pc - last_pc));
+  if (offset != last_offset)
+    put_zigzag(int64_t(offset - last_offset));
+  if (r.type != FETCH) {
+    put_zigzag(int64_t(r.vaddr - last_vaddr));
+    last_vaddr = r.vaddr;
+  }
+
+  last_hart = r.hart;
+  last_pc = r.pc;
+  last_offset = offset;
+  block_records++;
+}
+
+void memtrace_file_t::flush_block()
+{
+  if (block_records == 0)
+    return;
+
+  uint8_t header[8];
+  for (int i = 0; i < 4; i++) {
+    header[i] = uint8_t(block_len >> (8 * i));
+    header[4 + i] = uint8_t(block_records >> (8 * i));
+  }
+  fwrite(header, 1, sizeof(header), file);
+  fwrite(block.data(), 1, block_len, file);
+
+  block_len = 0;
+  block_records = 0;
+  last_hart = last_pc = last_vaddr = last_offset = 0;
+}
@@ -0,0 +1,77 @@
+// See LICENSE for license details.
+#ifndef _RISCV_MEMTRACE_FILE_H
+#define _RISCV_MEMTRACE_FILE_H
+
+#include "memtracer.h"
+#include <stdio.h>
+#include <vector>
+
+// Writes every memory access it sees to a compact binary trace file, for
+// replay through external cache and prefetch models.
+//
+// The file starts with the 8-byte magic "SPKMTR01", followed by blocks.
+// Each block is a little-endian uint32 payload length and uint32 record
+// count, then the records. Delta state is reset to zero at the start of
+// each block, so blocks can be decoded independently.
+//
+// Each record starts with a header byte:
+//   bits 1:0  type (0 load, 1 store, 2 fetch)
+//   bits 4:2  log2 of the size; 7 means a varint size follows
+//   bit 5     a varint hart ID follows
+//   bit 6     a zigzag varint PC delta follows
+//   bit 7     a zigzag varint delta of (paddr - vaddr) follows
+// Loads and stores then carry a zigzag varint vaddr delta from the previous
+// load or store. For fetches the vaddr is the PC and is not repeated.
+class memtrace_file_t : public memtracer_t
+{
+ public:
+  memtrace_file_t(const char* path, bool fetches);
+  ~memtrace_file_t();
+
+  // Only record accesses made while start <= instret < end.
+  void set_instret_window(uint64_t start, uint64_t end)
+  {
+    instret_start = start;
+    instret_end = end;
+  }
+  // Only record accesses made by instructions with lo <= pc < hi.
+  void set_pc_range(uint64_t lo, uint64_t hi)
+  {
+    pc_lo = lo;
+    pc_hi = hi;
+  }
+
+  bool interested_in_range(uint64_t begin, uint64_t end, access_type type)
+  {
+    return type != FETCH || fetches;
+  }
+  void trace(uint64_t addr, size_t bytes, access_type type) {}
+  void trace_record(const memtrace_record_t& r);
+  void clean_invalidate(uint64_t addr, size_t bytes, bool clean, bool inval) {}
+  uint64_t next_instret_boundary(uint64_t instret)
+  {
+    if (instret < instret_start)
+      return instret_start;
+    return instret < instret_end ? instret_end : UINT64_MAX;
+  }
+
+ private:
+  static const size_t BLOCK_SIZE = 64 << 10;
+  static const size_t MAX_RECORD_SIZE = 1 + 5 * 10;
+
+  FILE* file;
+  bool fetches;
+  uint64_t instret_start, instret_end;
+  uint64_t pc_lo, pc_hi;
+
+  std::vector<uint8_t> block;
+  size_t block_len;
+  uint32_t block_records;
+  uint64_t last_hart, last_pc, last_vaddr, last_offset;
+
+  void put_varint(uint64_t x);
+  void put_zigzag(int64_t x) { put_varint((uint64_t(x) << 1) ^ uint64_t(x >> 63)); }
+  void flush_block();
+};
+
+#endif
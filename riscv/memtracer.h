@@ -3,6 +3,7 @@
 #ifndef _MEMTRACER_H
 #define _MEMTRACER_H
 
+#include <algorithm>
 #include <cstdint>
 #include <string.h>
 #include <vector>
@@ -13,6 +14,21 @@ enum access_type {
   FETCH,
 };
 
+// A memory access together with the context it was made in.
+struct memtrace_record_t {
+  uint64_t hart;
+  // The hart's instret at the start of the step that made the access. No
+  // step runs past an instret boundary of any tracer (see
+  // next_instret_boundary), so this is on the same side of each boundary
+  // as the instruction that made the access.
+  uint64_t instret;
+  uint64_t pc;
+  uint64_t vaddr;
+  uint64_t paddr;
+  size_t bytes;
+  access_type type;
+};
+
 class memtracer_t
 {
  public:
@@ -21,7 +37,15 @@ class memtracer_t
 
   virtual bool interested_in_range(uint64_t begin, uint64_t end, access_type type) = 0;
   virtual void trace(uint64_t addr, size_t bytes, access_type type) = 0;
+  // Tracers that want more than the physical address override this.
+  virtual void trace_record(const memtrace_record_t& r) { trace(r.paddr, r.bytes, r.type); }
   virtual void clean_invalidate(uint64_t addr, size_t bytes, bool clean, bool inval) = 0;
+  // Return whether the access must be reported at once, ending the hart's
+  // step, rather than with the next batch.
+  virtual bool urgent(uint64_t addr, size_t bytes, access_type type) { return false; }
+  // The least instret above the given one at which the tracer starts or
+  // stops caring about accesses, or UINT64_MAX if there is none.
+  virtual uint64_t next_instret_boundary(uint64_t instret) { return UINT64_MAX; }
 };
 
 class memtracer_list_t : public memtracer_t
@@ -40,11 +64,30 @@ class memtracer_list_t : public memtracer_t
     for (auto it: list)
       it->trace(addr, bytes, type);
   }
+  void trace_record(const memtrace_record_t& r)
+  {
+    for (auto it: list)
+      it->trace_record(r);
+  }
   void clean_invalidate(uint64_t addr, size_t bytes, bool clean, bool inval)
   {
     for (auto it: list)
       it->clean_invalidate(addr, bytes, clean, inval);
   }
+  bool urgent(uint64_t addr, size_t bytes, access_type type)
+  {
+    for (auto it: list)
+      if (it->urgent(addr, bytes, type))
+        return true;
+    return false;
+  }
+  uint64_t next_instret_boundary(uint64_t instret)
+  {
+    uint64_t boundary = UINT64_MAX;
+    for (auto it: list)
+      boundary = std::min(boundary, it->next_instret_boundary(instret));
+    return boundary;
+  }
   void hook(memtracer_t* h)
   {
     list.push_back(h);
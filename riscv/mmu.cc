@@ -4,6 +4,7 @@
 #include "arith.h"
 #include "simif.h"
 #include "processor.h"
+#include "abstract_device.h"
 
 mmu_t::mmu_t(simif_t* sim, processor_t* proc)
  : sim(sim), proc(proc),
@@ -12,9 +13,9 @@ mmu_t::mmu_t(simif_t* sim, processor_t* proc)
 #endif
   check_triggers_fetch(false),
   check_triggers_load(false),
-  check_triggers_store(false),
-  matched_trigger(NULL)
+  check_triggers_store(false)
 {
+  trace_count = 0;
   flush_tlb();
   yield_load_reservation();
 }
@@ -34,6 +35,8 @@ void mmu_t::flush_tlb()
   memset(tlb_insn_tag, -1, sizeof(tlb_insn_tag));
   memset(tlb_load_tag, -1, sizeof(tlb_load_tag));
   memset(tlb_store_tag, -1, sizeof(tlb_store_tag));
+  for (size_t i = 0; i < MMIO_TLB_ENTRIES; i++)
+    mmio_tlb[i].tag = -1;
 
   flush_icache();
 }
@@ -123,11 +126,33 @@ bool mmu_t::mmio_ok(reg_t addr, access_type type)
   return true;
 }
 
+abstract_device_t* mmu_t::mmio_device(reg_t addr, size_t len, reg_t* base)
+{
+  reg_t ppn = addr >> PGSHIFT;
+  mmio_tlb_entry_t& entry = mmio_tlb[ppn % MMIO_TLB_ENTRIES];
+  if (entry.tag != ppn) {
+    entry.dev = sim->mmio_device(addr, &entry.base, &entry.end);
+    entry.tag = entry.dev ? ppn : -1;
+  }
+
+  // The page may hold more than one device, and the entry only the one that
+  // filled it. Accesses outside that device's range take the bus path.
+  if (entry.tag != ppn || addr < entry.base || addr + len < addr || addr + len > entry.end)
+    return NULL;
+
+  *base = entry.base;
+  return entry.dev;
+}
+
 bool mmu_t::mmio_load(reg_t addr, size_t len, uint8_t* bytes)
 {
   if (!mmio_ok(addr, LOAD))
     return false;
 
+  reg_t base;
+  if (auto dev = mmio_device(addr, len, &base))
+    return dev->load(addr - base, len, bytes);
+
   return sim->mmio_load(addr, len, bytes);
 }
 
@@ -136,6 +161,10 @@ bool mmu_t::mmio_store(reg_t addr, size_t len, const uint8_t* bytes)
   if (!mmio_ok(addr, STORE))
     return false;
 
+  reg_t base;
+  if (auto dev = mmio_device(addr, len, &base))
+    return dev->store(addr - base, len, bytes);
+
   return sim->mmio_store(addr, len, bytes);
 }
 
@@ -146,8 +175,8 @@ void mmu_t::load_slow_path(reg_t addr, reg_t len, uint8_t* bytes, uint32_t xlate
   if (auto host_addr = sim->addr_to_mem(paddr)) {
     memcpy(bytes, host_addr, len);
     if (tracer.interested_in_range(paddr, paddr + PGSIZE, LOAD))
-      tracer.trace(paddr, len, LOAD);
-    else if (xlate_flags == 0)
+      trace_access(addr, paddr, len, LOAD);
+    if (xlate_flags == 0)
       refill_tlb(addr, paddr, host_addr, LOAD);
   } else if (!mmio_load(paddr, len, bytes)) {
     throw trap_load_access_fault((proc) ? proc->state.v : false, addr, 0, 0);
@@ -173,11 +202,11 @@ void mmu_t::store_slow_path(reg_t addr, reg_t len, const uint8_t* bytes, uint32_
   }
 
   if (actually_store) {
-    if (auto host_addr = sim->addr_to_mem(paddr)) {
+    if (auto host_addr = sim->addr_to_mem_for_write(paddr)) {
       memcpy(host_addr, bytes, len);
       if (tracer.interested_in_range(paddr, paddr + PGSIZE, STORE))
-        tracer.trace(paddr, len, STORE);
-      else if (xlate_flags == 0)
+        trace_access(addr, paddr, len, STORE);
+      if (xlate_flags == 0)
         refill_tlb(addr, paddr, host_addr, STORE);
     } else if (!mmio_store(paddr, len, bytes)) {
       throw trap_store_access_fault((proc) ? proc->state.v : false, addr, 0, 0);
@@ -195,18 +224,23 @@ tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_
   if (proc && get_field(proc->state.mstatus->read(), MSTATUS_MPRV))
     return entry;
 
-  if ((tlb_load_tag[idx] & ~TLB_CHECK_TRIGGERS) != expected_tag)
+  if ((tlb_load_tag[idx] & ~TLB_FLAGS) != expected_tag)
     tlb_load_tag[idx] = -1;
-  if ((tlb_store_tag[idx] & ~TLB_CHECK_TRIGGERS) != expected_tag)
+  if ((tlb_store_tag[idx] & ~TLB_FLAGS) != expected_tag)
     tlb_store_tag[idx] = -1;
-  if ((tlb_insn_tag[idx] & ~TLB_CHECK_TRIGGERS) != expected_tag)
+  if ((tlb_insn_tag[idx] & ~TLB_FLAGS) != expected_tag)
     tlb_insn_tag[idx] = -1;
 
-  if ((check_triggers_fetch && type == FETCH) ||
-      (check_triggers_load && type == LOAD) ||
-      (check_triggers_store && type == STORE))
+  if ((check_triggers_fetch && type == FETCH && proc->TM.page_may_match(triggers::OPERATION_EXECUTE, vaddr)) ||
+      (check_triggers_load && type == LOAD && proc->TM.page_may_match(triggers::OPERATION_LOAD, vaddr)) ||
+      (check_triggers_store && type == STORE && proc->TM.page_may_match(triggers::OPERATION_STORE, vaddr)))
     expected_tag |= TLB_CHECK_TRIGGERS;
 
+  // Fetches are traced through the instruction cache instead.
+  reg_t page = paddr & ~reg_t(PGSIZE - 1);
+  if (type != FETCH && !tracer.empty() && tracer.interested_in_range(page, page + PGSIZE, type))
+    expected_tag |= TLB_TRACE;
+
   if (pmp_homogeneous(paddr & ~reg_t(PGSIZE - 1), PGSIZE)) {
     if (type == FETCH) tlb_insn_tag[idx] = expected_tag;
     else if (type == STORE) tlb_store_tag[idx] = expected_tag;
@@ -325,6 +359,7 @@ reg_t mmu_t::s2xlate(reg_t gva, reg_t gpa, access_type type, access_type trap_ty
         if ((pte & ad) != ad) {
           if (!pmp_ok(pte_paddr, vm.ptesize, STORE, PRV_S))
             throw_access_exception(virt, gva, trap_type);
+          ppte = sim->addr_to_mem_for_write(pte_paddr);
           *(target_endian<uint32_t>*)ppte |= to_target((uint32_t)ad);
         }
 #else
@@ -418,6 +453,7 @@ reg_t mmu_t::walk(reg_t addr, access_type type, reg_t mode, bool virt, bool hlvx
       if ((pte & ad) != ad) {
         if (!pmp_ok(pte_paddr, vm.ptesize, STORE, PRV_S))
           throw_access_exception(virt, addr, type);
+        ppte = sim->addr_to_mem_for_write(pte_paddr);
         *(target_endian<uint32_t>*)ppte |= to_target((uint32_t)ad);
       }
 #else
@@ -448,8 +484,19 @@ reg_t mmu_t::walk(reg_t addr, access_type type, reg_t mode, bool virt, bool hlvx
   }
 }
 
+void mmu_t::flush_trace()
+{
+  uint64_t hart = proc ? proc->get_id() : 0;
+  for (size_t i = 0; i < trace_count; i++) {
+    trace_buffer[i].hart = hart;
+    tracer.trace_record(trace_buffer[i]);
+  }
+  trace_count = 0;
+}
+
 void mmu_t::register_memtracer(memtracer_t* t)
 {
+  flush_trace();
   flush_tlb();
   tracer.hook(t);
 }
@@ -13,6 +13,7 @@
 #include "byteorder.h"
 #include "triggers.h"
 #include <stdlib.h>
+#include <optional>
 #include <vector>
 
 // virtual memory configuration
@@ -96,13 +97,16 @@ public:
         if (proc) READ_MEM(addr, size); \
         return from_target(*(target_endian<type##_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr)); \
       } \
-      if ((xlate_flags) == 0 && unlikely(tlb_load_tag[vpn % TLB_ENTRIES] == (vpn | TLB_CHECK_TRIGGERS))) { \
+      if ((xlate_flags) == 0 && unlikely((tlb_load_tag[vpn % TLB_ENTRIES] & ~TLB_FLAGS) == vpn)) { \
+        reg_t tag = tlb_load_tag[vpn % TLB_ENTRIES]; \
         type##_t data = from_target(*(target_endian<type##_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr)); \
-        if (!matched_trigger) { \
+        if ((tag & TLB_CHECK_TRIGGERS) && !matched_trigger) { \
           matched_trigger = trigger_exception(triggers::OPERATION_LOAD, addr, data); \
           if (matched_trigger) \
             throw *matched_trigger; \
         } \
+        if (tag & TLB_TRACE) \
+          trace_access(addr, tlb_data[vpn % TLB_ENTRIES].target_offset + addr, size, LOAD); \
         if (proc) READ_MEM(addr, size); \
         return data; \
       } \
@@ -160,13 +164,16 @@ public:
           *(target_endian<type##_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr) = to_target(val); \
         } \
       } \
-      else if ((xlate_flags) == 0 && unlikely(tlb_store_tag[vpn % TLB_ENTRIES] == (vpn | TLB_CHECK_TRIGGERS))) { \
+      else if ((xlate_flags) == 0 && unlikely((tlb_store_tag[vpn % TLB_ENTRIES] & ~TLB_FLAGS) == vpn)) { \
         if (actually_store) { \
-          if (!matched_trigger) { \
+          reg_t tag = tlb_store_tag[vpn % TLB_ENTRIES]; \
+          if ((tag & TLB_CHECK_TRIGGERS) && !matched_trigger) { \
             matched_trigger = trigger_exception(triggers::OPERATION_STORE, addr, val); \
             if (matched_trigger) \
               throw *matched_trigger; \
           } \
+          if (tag & TLB_TRACE) \
+            trace_access(addr, tlb_data[vpn % TLB_ENTRIES].target_offset + addr, size, STORE); \
           if (proc) WRITE_MEM(addr, val, size); \
           *(target_endian<type##_t>*)(tlb_data[vpn % TLB_ENTRIES].host_offset + addr) = to_target(val); \
         } \
@@ -259,6 +266,23 @@ public:
     })
   }
 
+  // Vector memory instructions touch many elements on a page, so they look
+  // each page up once and then access host memory directly. Returns the
+  // host address of the page holding addr if its TLB entry for this access
+  // type needs no tracing, trigger checks or commit logging, else NULL.
+  inline char* host_page(reg_t addr, access_type type)
+  {
+#ifdef RISCV_ENABLE_COMMITLOG
+    return NULL;
+#else
+    reg_t vpn = addr >> PGSHIFT;
+    reg_t tag = type == STORE ? tlb_store_tag[vpn % TLB_ENTRIES] : tlb_load_tag[vpn % TLB_ENTRIES];
+    if (likely(tag == vpn))
+      return tlb_data[vpn % TLB_ENTRIES].host_offset + (vpn << PGSHIFT);
+    return NULL;
+#endif
+  }
+
   inline void yield_load_reservation()
   {
     load_reservation_address = (reg_t)-1;
@@ -299,7 +323,7 @@ public:
       store_conditional_address_misaligned(vaddr);
 
     reg_t paddr = translate(vaddr, 1, STORE, 0);
-    if (auto host_addr = sim->addr_to_mem(paddr))
+    if (auto host_addr = sim->addr_to_mem_for_write(paddr))
       return load_reservation_address == refill_tlb(vaddr, paddr, host_addr, STORE).target_offset + vaddr;
     else
       throw trap_store_access_fault((proc) ? proc->state.v : false, vaddr, 0, 0); // disallow SC to I/O space
@@ -339,17 +363,29 @@ public:
 
     reg_t paddr = tlb_entry.target_offset + addr;;
     if (tracer.interested_in_range(paddr, paddr + 1, FETCH)) {
-      entry->tag = -1;
-      tracer.trace(paddr, length, FETCH);
+      // Keep the decoded instruction, but tag it so that every fetch of it
+      // takes trace_fetch() instead of the fast path.
+      entry->tag = addr | ICACHE_TRACED;
+      trace_access(addr, paddr, length, FETCH);
     }
     return entry;
   }
 
+  void trace_fetch(reg_t addr, icache_entry_t* entry)
+  {
+    reg_t paddr = translate_insn_addr(addr).target_offset + addr;
+    trace_access(addr, paddr, entry->data.insn.length(), FETCH);
+  }
+
   inline icache_entry_t* access_icache(reg_t addr)
   {
     icache_entry_t* entry = &icache[icache_index(addr)];
     if (likely(entry->tag == addr))
       return entry;
+    if (entry->tag == (addr | ICACHE_TRACED) && entry->tag != reg_t(-1)) {
+      trace_fetch(addr, entry);
+      return entry;
+    }
     return refill_icache(addr, entry);
   }
 
@@ -361,8 +397,11 @@ public:
 
   void flush_tlb();
   void flush_icache();
+  // Hand buffered accesses to traced pages to the registered memtracers.
+  void flush_trace();
 
   void register_memtracer(memtracer_t*);
+  uint64_t next_trace_boundary(uint64_t instret) { return tracer.next_instret_boundary(instret); }
 
   int is_dirty_enabled()
   {
@@ -421,17 +460,60 @@ private:
 
   // implement an instruction cache for simulator performance
   icache_entry_t icache[ICACHE_ENTRIES];
+  // instructions on traced pages are cached with this bit set in their tag
+  static const reg_t ICACHE_TRACED = 1;
+
+  // Accesses to traced pages are recorded here and handed to the
+  // memtracers in batches, by flush_trace() or when the buffer fills.
+  // The hart field is filled in when the buffer is flushed.
+  static const size_t TRACE_BUFFER_ENTRIES = 1024;
+  memtrace_record_t trace_buffer[TRACE_BUFFER_ENTRIES];
+  size_t trace_count;
+
+  inline void trace_access(reg_t vaddr, reg_t paddr, size_t bytes, access_type type)
+  {
+    memtrace_record_t& r = trace_buffer[trace_count++];
+    r.pc = type == FETCH || !proc ? vaddr : proc->state.pc;
+    r.instret = proc ? proc->state.minstret->read() : 0;
+    r.vaddr = vaddr;
+    r.paddr = paddr;
+    r.bytes = bytes;
+    r.type = type;
+    // The debug MMU has no hart to flush it, so it reports right away.
+    if (unlikely(trace_count == TRACE_BUFFER_ENTRIES) || !proc) {
+      flush_trace();
+    } else if (unlikely(tracer.urgent(paddr, bytes, type))) {
+      flush_trace();
+      proc->request_yield();
+    }
+  }
 
   // implement a TLB for simulator performance
   static const reg_t TLB_ENTRIES = 256;
   // If a TLB tag has TLB_CHECK_TRIGGERS set, then the MMU must check for a
-  // trigger match before completing an access.
+  // trigger match before completing an access. Only pages that some armed
+  // trigger can match (see triggers::module_t::page_may_match) are tagged.
   static const reg_t TLB_CHECK_TRIGGERS = reg_t(1) << 63;
+  // If a TLB tag has TLB_TRACE set, some memtracer is interested in the
+  // page, so accesses through that entry are recorded with trace_access().
+  static const reg_t TLB_TRACE = reg_t(1) << 62;
+  static const reg_t TLB_FLAGS = TLB_CHECK_TRIGGERS | TLB_TRACE;
   tlb_entry_t tlb_data[TLB_ENTRIES];
   reg_t tlb_insn_tag[TLB_ENTRIES];
   reg_t tlb_load_tag[TLB_ENTRIES];
   reg_t tlb_store_tag[TLB_ENTRIES];
 
+  // implement a small physically-tagged cache of MMIO devices, so repeated
+  // accesses to the same device page skip the bus lookup
+  static const reg_t MMIO_TLB_ENTRIES = 4;
+  struct mmio_tlb_entry_t {
+    reg_t tag;
+    reg_t base;
+    reg_t end;
+    abstract_device_t* dev;
+  };
+  mmio_tlb_entry_t mmio_tlb[MMIO_TLB_ENTRIES];
+
   // finish translation on a TLB miss and update the TLB
   tlb_entry_t refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_type type);
   const char* fill_from_mmio(reg_t vaddr, reg_t paddr);
@@ -449,6 +531,7 @@ private:
   bool mmio_load(reg_t addr, size_t len, uint8_t* bytes);
   bool mmio_store(reg_t addr, size_t len, const uint8_t* bytes);
   bool mmio_ok(reg_t addr, access_type type);
+  abstract_device_t* mmio_device(reg_t addr, size_t len, reg_t* base);
   reg_t translate(reg_t addr, reg_t len, access_type type, uint32_t xlate_flags);
 
   // ITLB lookup
@@ -477,20 +560,20 @@ private:
     return (uint16_t*)(translate_insn_addr(addr).host_offset + addr);
   }
 
-  inline triggers::matched_t *trigger_exception(triggers::operation_t operation,
+  inline std::optional<triggers::matched_t> trigger_exception(triggers::operation_t operation,
       reg_t address, reg_t data)
   {
-    if (!proc) {
-      return NULL;
+    if (!proc || !proc->TM.page_may_match(operation, address)) {
+      return std::nullopt;
     }
     triggers::action_t action;
     auto match = proc->TM.memory_access_match(&action, operation, address, data);
     if (match == triggers::MATCH_NONE)
-      return NULL;
+      return std::nullopt;
     if (match == triggers::MATCH_FIRE_BEFORE) {
       throw triggers::matched_t(operation, address, data, action);
     }
-    return new triggers::matched_t(operation, address, data, action);
+    return triggers::matched_t(operation, address, data, action);
   }
 
   reg_t pmp_homogeneous(reg_t addr, reg_t len);
@@ -504,8 +587,8 @@ private:
   bool check_triggers_fetch;
   bool check_triggers_load;
   bool check_triggers_store;
-  // The exception describing a matched trigger, or NULL.
-  triggers::matched_t *matched_trigger;
+  // The exception describing a matched trigger, if any.
+  std::optional<triggers::matched_t> matched_trigger;
 
   friend class processor_t;
 };
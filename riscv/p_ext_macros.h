@@ -59,6 +59,136 @@
     R = 0; \
   }
 
+// Whole-register (SWAR) forms of the 8- and 16-bit lane add and subtract
+// families, which work on every lane of a 64-bit word at once. Each takes
+// the register values a and b and ORs into ov the top bit of every lane
+// that saturated. The per-lane P_LOOP forms remain the reference, and are
+// built instead when P_HOST_SWAR is defined to 0.
+#ifndef P_HOST_SWAR
+#define P_HOST_SWAR 1
+#endif
+
+template<int BIT>
+static inline uint64_t p_swar_lsb()
+{
+  return BIT == 8 ? UINT64_C(0x0101010101010101) : UINT64_C(0x0001000100010001);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_msb()
+{
+  return p_swar_lsb<BIT>() << (BIT - 1);
+}
+
+// Widen the top bit of each lane of x to the whole lane.
+template<int BIT>
+static inline uint64_t p_swar_lanes(uint64_t x)
+{
+  return ((x & p_swar_msb<BIT>()) >> (BIT - 1)) * ((UINT64_C(1) << BIT) - 1);
+}
+
+// Shift each lane right by one, logically or arithmetically.
+template<int BIT>
+static inline uint64_t p_swar_shr1(uint64_t x)
+{
+  return (x >> 1) & ~p_swar_msb<BIT>();
+}
+
+template<int BIT>
+static inline uint64_t p_swar_sra1(uint64_t x)
+{
+  return p_swar_shr1<BIT>(x) | (x & p_swar_msb<BIT>());
+}
+
+template<int BIT>
+static inline uint64_t p_swar_add(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  const uint64_t h = p_swar_msb<BIT>();
+  return ((a & ~h) + (b & ~h)) ^ ((a ^ b) & h);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_sub(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  const uint64_t h = p_swar_msb<BIT>();
+  return ((a | h) - (b & ~h)) ^ ((a ^ ~b) & h);
+}
+
+// Signed saturation gives INT_MAX, or INT_MIN when a is negative.
+template<int BIT>
+static inline uint64_t p_swar_sat(uint64_t s, uint64_t a, uint64_t sat, uint64_t &ov)
+{
+  const uint64_t h = p_swar_msb<BIT>();
+  const uint64_t m = p_swar_lanes<BIT>(sat);
+  ov |= sat & h;
+  return (s & ~m) | ((~h + ((a & h) >> (BIT - 1))) & m);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_kadd(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  const uint64_t s = p_swar_add<BIT>(a, b, ov);
+  return p_swar_sat<BIT>(s, a, (a ^ s) & (b ^ s), ov);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_ksub(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  const uint64_t s = p_swar_sub<BIT>(a, b, ov);
+  return p_swar_sat<BIT>(s, a, (a ^ b) & (a ^ s), ov);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_ukadd(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  const uint64_t s = p_swar_add<BIT>(a, b, ov);
+  const uint64_t carry = ((a & b) | ((a | b) & ~s)) & p_swar_msb<BIT>();
+  ov |= carry;
+  return s | p_swar_lanes<BIT>(carry);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_uksub(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  const uint64_t s = p_swar_sub<BIT>(a, b, ov);
+  const uint64_t borrow = ((~a & b) | (~(a ^ b) & s)) & p_swar_msb<BIT>();
+  ov |= borrow;
+  return s & ~p_swar_lanes<BIT>(borrow);
+}
+
+// Halving forms: (a + b) >> 1 is (a & b) + ((a ^ b) >> 1), and (a - b) >> 1
+// is the rounded-up average of a and ~b, (a | ~b) - ((a ^ ~b) >> 1), which
+// unsigned lanes bias by half their range.
+template<int BIT>
+static inline uint64_t p_swar_radd(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  return p_swar_add<BIT>(a & b, p_swar_sra1<BIT>(a ^ b), ov);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_uradd(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  return p_swar_add<BIT>(a & b, p_swar_shr1<BIT>(a ^ b), ov);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_rsub(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  return p_swar_sub<BIT>(a | ~b, p_swar_sra1<BIT>(a ^ ~b), ov);
+}
+
+template<int BIT>
+static inline uint64_t p_swar_ursub(uint64_t a, uint64_t b, uint64_t &ov)
+{
+  return p_swar_sub<BIT>(a | ~b, p_swar_shr1<BIT>(a ^ ~b), ov) ^ p_swar_msb<BIT>();
+}
+
+// Swap the 16-bit halves of each 32-bit word, for the cross forms.
+static inline uint64_t p_swar_swap16(uint64_t x)
+{
+  return ((x >> 16) & UINT64_C(0x0000ffff0000ffff)) | ((x << 16) & UINT64_C(0xffff0000ffff0000));
+}
+
 #define P_LOOP_BASE(BIT) \
   require_extension(EXT_ZPN); \
   require(BIT == e8 || BIT == e16 || BIT == e32); \
@@ -304,6 +434,69 @@
   P_ULOOP_BODY(BIT, BODY2) \
   P_LOOP_END()
 
+// Lanes above xlen hold sign-extension and must not set vxsat.
+#define P_SWAR_END(OV) \
+  P_SET_OV((OV) & (xlen == 64 ? UINT64_MAX : UINT64_C(0xffffffff))); \
+  WRITE_RD(sext_xlen(rd_tmp));
+
+#define P_SWAR_LOOP_BASE(BIT, OP, RS2_VAL) \
+  require_extension(EXT_ZPN); \
+  uint64_t ov = 0; \
+  reg_t rd_tmp = p_swar_##OP<BIT>(RS1, RS2_VAL, ov); \
+  P_SWAR_END(ov)
+
+// The high 16-bit lane of each word gets OP1, and the low lane OP2.
+#define P_SWAR_PAIR_LOOP_BASE(BIT, OP1, OP2, RS2_VAL) \
+  require_extension(EXT_ZPN); \
+  const uint64_t hi = UINT64_C(0xffff0000ffff0000); \
+  const reg_t rs1 = RS1, rs2 = RS2_VAL; \
+  uint64_t ov1 = 0, ov2 = 0; \
+  reg_t rd_tmp = (p_swar_##OP1<BIT>(rs1, rs2, ov1) & hi) | \
+                 (p_swar_##OP2<BIT>(rs1, rs2, ov2) & ~hi); \
+  P_SWAR_END((ov1 & hi) | (ov2 & ~hi))
+
+#define P_SWAR_LOOP(BIT, OP, BODY) \
+  if (P_HOST_SWAR) { \
+    P_SWAR_LOOP_BASE(BIT, OP, RS2) \
+  } else { \
+    P_LOOP(BIT, BODY) \
+  }
+
+#define P_SWAR_ULOOP(BIT, OP, BODY) \
+  if (P_HOST_SWAR) { \
+    P_SWAR_LOOP_BASE(BIT, OP, RS2) \
+  } else { \
+    P_ULOOP(BIT, BODY) \
+  }
+
+#define P_SWAR_CROSS_LOOP(BIT, OP1, OP2, BODY1, BODY2) \
+  if (P_HOST_SWAR) { \
+    P_SWAR_PAIR_LOOP_BASE(BIT, OP1, OP2, p_swar_swap16(RS2)) \
+  } else { \
+    P_CROSS_LOOP(BIT, BODY1, BODY2) \
+  }
+
+#define P_SWAR_CROSS_ULOOP(BIT, OP1, OP2, BODY1, BODY2) \
+  if (P_HOST_SWAR) { \
+    P_SWAR_PAIR_LOOP_BASE(BIT, OP1, OP2, p_swar_swap16(RS2)) \
+  } else { \
+    P_CROSS_ULOOP(BIT, BODY1, BODY2) \
+  }
+
+#define P_SWAR_STRAIGHT_LOOP(BIT, OP1, OP2, BODY1, BODY2) \
+  if (P_HOST_SWAR) { \
+    P_SWAR_PAIR_LOOP_BASE(BIT, OP1, OP2, RS2) \
+  } else { \
+    P_STRAIGHT_LOOP(BIT, BODY1, BODY2) \
+  }
+
+#define P_SWAR_STRAIGHT_ULOOP(BIT, OP1, OP2, BODY1, BODY2) \
+  if (P_HOST_SWAR) { \
+    P_SWAR_PAIR_LOOP_BASE(BIT, OP1, OP2, RS2) \
+  } else { \
+    P_STRAIGHT_ULOOP(BIT, BODY1, BODY2) \
+  }
+
 #define P_X_LOOP(BIT, RS2_LOW_BIT, BODY) \
   P_X_LOOP_BASE(BIT, RS2_LOW_BIT) \
   P_ONE_LOOP_BODY(BIT, BODY) \
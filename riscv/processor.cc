@@ -9,6 +9,7 @@
 #include "mmu.h"
 #include "disasm.h"
 #include "platform.h"
+#include "timing_model.h"
 #include <cinttypes>
 #include <cmath>
 #include <cstdlib>
@@ -26,9 +27,9 @@
 processor_t::processor_t(const isa_parser_t *isa, const char* varch,
                          simif_t* sim, uint32_t id, bool halt_on_reset,
                          FILE* log_file, std::ostream& sout_)
-  : debug(false), halt_request(HR_NONE), isa(isa), sim(sim), id(id), xlen(0),
-  histogram_enabled(false), log_commits_enabled(false),
-  log_file(log_file), sout_(sout_.rdbuf()), halt_on_reset(halt_on_reset),
+  : debug(false), halt_request(HR_NONE), isa(isa), sim(sim), timing(NULL), id(id),
+  xlen(0), histogram_enabled(false), log_commits_enabled(false),
+  host_fp(false), yield_requested(false), in_wfi(false), log_file(log_file), sout_(sout_.rdbuf()), halt_on_reset(halt_on_reset),
   impl_table(256, false), last_pc(1), executions(1), TM(4)
 {
   VU.p = this;
@@ -77,6 +78,7 @@ processor_t::~processor_t()
 
   delete mmu;
   delete disassembler;
+  delete timing;
 }
 
 static void bad_option_string(const char *option, const char *value,
@@ -498,6 +500,7 @@ void processor_t::reset()
   state.reset(this, isa->get_max_isa());
   state.dcsr->halt = halt_on_reset;
   halt_on_reset = false;
+  in_wfi = false;
   VU.reset();
 
   if (n_pmp > 0) {
@@ -728,6 +731,9 @@ void processor_t::take_trap(trap_t& t, reg_t epc)
     return;
   }
 
+  if (state.prv == PRV_U && sim && sim->handle_user_trap(this, t, epc))
+    return;
+
   // By default, trap to M-mode, unless delegated to HS-mode or VS-mode
   reg_t vsdeleg, hsdeleg;
   reg_t bit = t.cause();
@@ -24,6 +24,7 @@ class simif_t;
 class trap_t;
 class extension_t;
 class disassembler_t;
+class timing_model_t;
 
 reg_t illegal_instruction(processor_t* p, insn_t insn, reg_t pc);
 
@@ -240,12 +241,26 @@ public:
   bool get_log_commits_enabled() const { return log_commits_enabled; }
 #endif
   void reset();
-  void step(size_t n); // run for n cycles
+  size_t step(size_t n); // run for n cycles; returns the instructions retired
+  // End the current step after the instruction being executed.
+  void request_yield() { yield_requested = true; }
+  // A waiting hart, such as one that has executed WFI, runs nothing until
+  // an enabled interrupt is pending, or until it is told to stop waiting.
+  void set_waiting(bool value) { in_wfi = value; }
+  bool is_waiting() { return in_wfi && !(state.mip->read() & state.mie->read()); }
   void put_csr(int which, reg_t val);
   uint32_t get_id() const { return id; }
   reg_t get_csr(int which, insn_t insn, bool write, bool peek = 0);
   reg_t get_csr(int which) { return get_csr(which, insn_t(0), false, true); }
   mmu_t* get_mmu() { return mmu; }
+  // Drive mcycle from t, which the processor then owns, instead of
+  // assuming a CPI of 1.
+  void set_timing_model(timing_model_t* t) { timing = t; }
+  timing_model_t* get_timing_model() { return timing; }
+  // Run scalar F and D arithmetic on the host FPU where that gives the
+  // same result and flags as softfloat.
+  void set_host_fp(bool value) { host_fp = value; }
+  bool host_fp_enabled() const { return host_fp; }
   state_t* get_state() { return &state; }
   unsigned get_xlen() const { return xlen; }
   unsigned get_const_xlen() const {
@@ -331,11 +346,15 @@ private:
   mmu_t* mmu; // main memory is always accessed via the mmu
   std::unordered_map<std::string, extension_t*> custom_extensions;
   disassembler_t* disassembler;
+  timing_model_t* timing;
   state_t state;
   uint32_t id;
   unsigned xlen;
   bool histogram_enabled;
   bool log_commits_enabled;
+  bool host_fp;
+  bool yield_requested;
+  bool in_wfi;
   FILE *log_file;
   std::ostream sout_; // needed for socket command interface -s, also used for -d and -l, but not for --log
   bool halt_on_reset;
@@ -416,6 +435,13 @@ public:
           T *regStart = (T*)((char*)reg_file + vReg * (VLEN >> 3));
           return regStart[n];
         }
+
+      // The register group starting at vReg as a flat array, which on
+      // little-endian hosts holds the group's elements in order.
+      template<class T>
+        T* elt_group(reg_t vReg){
+          return (T*)((char*)reg_file + vReg * (VLEN >> 3));
+        }
     public:
 
       void reset();
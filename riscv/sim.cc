@@ -6,7 +6,9 @@
 #include "remote_bitbang.h"
 #include "byteorder.h"
 #include "platform.h"
+#include "timing_model.h"
 #include "libfdt.h"
+#include <algorithm>
 #include <fstream>
 #include <map>
 #include <iostream>
@@ -56,6 +58,9 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
     sout_(nullptr),
     current_step(0),
     current_proc(0),
+    round_cycles(0),
+    turn_insns(0),
+    rtc_cycles(0),
     debug(false),
     histogram_enabled(false),
     log(false),
@@ -94,7 +99,8 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
   // setting the dtb_file argument has one.
   reg_t clint_base;
   if (fdt_parse_clint(fdt, &clint_base, "riscv,clint0") == 0) {
-    clint.reset(new clint_t(procs, CPU_HZ / INSNS_PER_RTC_TICK, cfg->real_time_clint()));
+    clint.reset(new clint_t(procs, CPU_HZ / INSNS_PER_RTC_TICK, cfg->real_time_clint(),
+                            cfg->real_time_clint_scale));
     bus.add_device(clint_base, clint.get());
   }
 
@@ -176,17 +182,14 @@ sim_t::~sim_t()
   delete debug_mmu;
 }
 
-void sim_thread_main(void* arg)
+int sim_t::run()
 {
-  ((sim_t*)arg)->main();
-}
+  start();
 
-void sim_t::main()
-{
   if (!debug && log)
     set_procs_debug(true);
 
-  while (!done())
+  while (!exit_requested())
   {
     if (debug || ctrlc_pressed)
       interactive();
@@ -196,13 +199,10 @@ void sim_t::main()
       remote_bitbang->tick();
     }
   }
-}
 
-int sim_t::run()
-{
-  host = context_t::current();
-  target.init(sim_thread_main, this);
-  return htif_t::run();
+  stop();
+
+  return exit_code();
 }
 
 void sim_t::step(size_t n)
@@ -210,23 +210,63 @@ void sim_t::step(size_t n)
   for (size_t i = 0, steps = 0; i < n; i += steps)
   {
     steps = std::min(n - i, INTERLEAVE - current_step);
-    procs[current_proc]->step(steps);
+    // End the step at the memtracers' next instret boundary, so that every
+    // access in it is on one side of the boundary.
+    processor_t* proc = procs[current_proc];
+    reg_t instret = proc->get_state()->minstret->read();
+    steps = std::min<reg_t>(steps, proc->get_mmu()->next_trace_boundary(instret) - instret);
+    size_t retired = proc->step(steps);
+    turn_insns += retired;
+
+    // A store to tohost ends the quantum early, so the host sees it at once.
+    // Only the instructions run count against the quantum and the budget.
+    bool rung = tohost_doorbell.has_rung();
+    if (rung)
+      steps = retired;
 
     current_step += steps;
-    if (current_step == INTERLEAVE)
+    if (current_step == INTERLEAVE || rung)
     {
       current_step = 0;
-      procs[current_proc]->get_mmu()->yield_load_reservation();
+      proc->get_mmu()->yield_load_reservation();
+      auto timing = proc->get_timing_model();
+      reg_t turn_cycles = timing ? timing->take_elapsed() : turn_insns;
+      turn_insns = 0;
+      // A hart idle in WFI would have spent the whole quantum waiting.
+      if (proc->is_waiting())
+        turn_cycles = std::max<reg_t>(turn_cycles, INTERLEAVE);
+      round_cycles = std::max(round_cycles, turn_cycles);
       if (++current_proc == procs.size()) {
         current_proc = 0;
-        if (clint) clint->increment(INTERLEAVE / INSNS_PER_RTC_TICK);
+        if (clint) {
+          clint->increment(rtc_ticks());
+          // Nothing happens until a timer fires when every hart is waiting.
+          if (std::all_of(procs.begin(), procs.end(), [](processor_t* p) { return p->is_waiting(); }))
+            clint->skip_to_next_deadline();
+        }
+        if (linux_user)
+          linux_user->tick();
       }
 
-      host->switch_to();
+      if (get_tohost_addr()) {
+        handle_tohost();
+        tick_devices();
+      }
+      if (exit_requested())
+        return;
     }
   }
 }
 
+size_t sim_t::rtc_ticks()
+{
+  rtc_cycles += round_cycles;
+  round_cycles = 0;
+  size_t ticks = rtc_cycles / INSNS_PER_RTC_TICK;
+  rtc_cycles %= INSNS_PER_RTC_TICK;
+  return ticks;
+}
+
 void sim_t::set_debug(bool value)
 {
   debug = value;
@@ -285,6 +325,16 @@ bool sim_t::mmio_store(reg_t addr, size_t len, const uint8_t* bytes)
   return bus.store(addr, len, bytes);
 }
 
+abstract_device_t* sim_t::mmio_device(reg_t addr, reg_t* base, reg_t* end)
+{
+  if (!paddr_ok(addr))
+    return NULL;
+  auto range = bus.find_range(addr);
+  *base = range.base;
+  *end = std::min(range.end, reg_t(1) << MAX_PADDR_BITS);
+  return range.dev;
+}
+
 void sim_t::make_dtb()
 {
   if (!dtb_file.empty()) {
@@ -362,16 +412,23 @@ void sim_t::set_rom()
 
   boot_rom.reset(new rom_device_t(rom));
   bus.add_device(DEFAULT_RSTVEC, boot_rom.get());
+
+  // The MMUs cache MMIO device lookups, which the new ROM may invalidate.
+  debug_mmu->flush_tlb();
+  for (auto proc : procs)
+    proc->get_mmu()->flush_tlb();
 }
 
 char* sim_t::addr_to_mem(reg_t addr) {
   if (!paddr_ok(addr))
     return NULL;
-  auto desc = bus.find_device(addr);
-  if (auto mem = dynamic_cast<mem_t*>(desc.second))
-    if (addr - desc.first < mem->size())
-      return mem->contents(addr - desc.first);
-  return NULL;
+  return bus.addr_to_mem(addr);
+}
+
+char* sim_t::addr_to_mem_for_write(reg_t addr) {
+  if (!paddr_ok(addr))
+    return NULL;
+  return bus.addr_to_mem(addr, true);
 }
 
 const char* sim_t::get_symbol(uint64_t addr)
@@ -381,30 +438,148 @@ const char* sim_t::get_symbol(uint64_t addr)
 
 // htif
 
+void sim_t::load_program()
+{
+  if (!cfg->linux_user) {
+    htif_t::load_program();
+    return;
+  }
+
+  linux_user.reset(new linux_user_t(this, procs, mems[0].first, mems[0].second->size()));
+  linux_user->load(target_args());
+}
+
+bool sim_t::handle_user_trap(processor_t* proc, trap_t& t, reg_t epc)
+{
+  if (!linux_user || !linux_user->handle_trap(proc, t, epc))
+    return false;
+
+  if (linux_user->exited())
+    set_exit_code(linux_user->exit_status());
+  return true;
+}
+
 void sim_t::reset()
 {
   if (dtb_enabled)
     set_rom();
+
+  if (get_tohost_addr() && !tohost_doorbell.get_addr()) {
+    tohost_doorbell.set_addr(get_tohost_addr());
+    debug_mmu->register_memtracer(&tohost_doorbell);
+    for (auto p : procs)
+      p->get_mmu()->register_memtracer(&tohost_doorbell);
+  }
 }
 
-void sim_t::idle()
+bool tohost_doorbell_t::interested_in_range(uint64_t begin, uint64_t end, access_type type)
 {
-  target.switch_to();
+  // The MMU caches translations a page at a time, so claim the whole page.
+  reg_t page = addr & ~reg_t(PGSIZE - 1);
+  return type == STORE && page < end && page + PGSIZE > begin;
+}
+
+void tohost_doorbell_t::trace(uint64_t addr, size_t bytes, access_type type)
+{
+  if (hits(addr, bytes, type))
+    rung = true;
+}
+
+bool sim_t::tohost_may_be_pending()
+{
+  // Until the doorbell is armed, fall back to polling.
+  return !tohost_doorbell.get_addr() || tohost_doorbell.test_and_clear();
+}
+
+// Return the host address backing [addr, addr + len) if the whole range is
+// contiguous RAM, or NULL.
+char* sim_t::contiguous_mem(reg_t addr, size_t len, bool write)
+{
+  char* host_addr = write ? addr_to_mem_for_write(addr) : addr_to_mem(addr);
+  if (host_addr && addr_to_mem(addr + len - 1) == host_addr + len - 1)
+    return host_addr;
+  return NULL;
 }
 
 void sim_t::read_chunk(addr_t taddr, size_t len, void* dst)
 {
-  assert(len == 8);
-  auto data = debug_mmu->to_target(debug_mmu->load_uint64(taddr));
-  memcpy(dst, &data, sizeof data);
+  assert(len % 8 == 0 && taddr % 8 == 0);
+  for (size_t pos = 0, n; pos < len; pos += n) {
+    n = std::min(len - pos, size_t(PGSIZE - ((taddr + pos) % PGSIZE)));
+    if (char* host_addr = contiguous_mem(taddr + pos, n, false)) {
+      memcpy((char*)dst + pos, host_addr, n);
+      continue;
+    }
+
+    for (size_t i = 0; i < n; i += 8) {
+      auto data = debug_mmu->to_target(debug_mmu->load_uint64(taddr + pos + i));
+      memcpy((char*)dst + pos + i, &data, sizeof data);
+    }
+  }
 }
 
 void sim_t::write_chunk(addr_t taddr, size_t len, const void* src)
 {
-  assert(len == 8);
-  target_endian<uint64_t> data;
-  memcpy(&data, src, sizeof data);
-  debug_mmu->store_uint64(taddr, debug_mmu->from_target(data));
+  assert(len % 8 == 0 && taddr % 8 == 0);
+  for (size_t pos = 0, n; pos < len; pos += n) {
+    n = std::min(len - pos, size_t(PGSIZE - ((taddr + pos) % PGSIZE)));
+    if (char* host_addr = contiguous_mem(taddr + pos, n, true)) {
+      memcpy(host_addr, (const char*)src + pos, n);
+      continue;
+    }
+
+    for (size_t i = 0; i < n; i += 8) {
+      target_endian<uint64_t> data;
+      memcpy(&data, (const char*)src + pos + i, sizeof data);
+      debug_mmu->store_uint64(taddr + pos + i, debug_mmu->from_target(data));
+    }
+  }
+}
+
+void sim_t::clear_chunk(addr_t taddr, size_t len)
+{
+  assert(len % 8 == 0 && taddr % 8 == 0);
+  for (size_t pos = 0, n; pos < len; pos += n) {
+    n = std::min(len - pos, size_t(PGSIZE - ((taddr + pos) % PGSIZE)));
+    if (char* host_addr = contiguous_mem(taddr + pos, n, true)) {
+      memset(host_addr, 0, n);
+      continue;
+    }
+
+    for (size_t i = 0; i < n; i += 8)
+      debug_mmu->store_uint64(taddr + pos + i, 0);
+  }
+}
+
+bool sim_t::is_address_preloaded(addr_t taddr, size_t len)
+{
+  // A payload segment over the kernel or initrd is almost surely a mistake,
+  // but the payload still wins, as it did when those were copied in.
+  for (auto& r : preloaded_ranges) {
+    if (len && taddr < r.first + r.second && r.first < taddr + len) {
+      fprintf(stderr, "warning: payload writes 0x%" PRIx64 "-0x%" PRIx64
+              ", overlapping the image loaded at 0x%" PRIx64 "-0x%" PRIx64 "\n",
+              taddr, taddr + len, r.first, r.first + r.second);
+    }
+  }
+
+  return false;
+}
+
+void* sim_t::chunk_host_ptr(addr_t taddr, size_t len)
+{
+  // The caller may write through the result.
+  // Check each page, since RAM that is contiguous in the target need not be
+  // contiguous on the host.
+  char* base = NULL;
+  for (size_t pos = 0, n; pos < len; pos += n) {
+    n = std::min(len - pos, size_t(PGSIZE - ((taddr + pos) % PGSIZE)));
+    char* host_addr = contiguous_mem(taddr + pos, n, true);
+    if (!host_addr || (base && host_addr != base + pos))
+      return NULL;
+    base = host_addr - pos;
+  }
+  return base;
 }
 
 void sim_t::set_target_endianness(memif_endianness_t endianness)
@@ -435,4 +610,11 @@ memif_endianness_t sim_t::get_target_endianness() const
 void sim_t::proc_reset(unsigned id)
 {
   debug_module.proc_reset(id);
+
+  // Resetting a hart clears its mip, so restore a pending timer interrupt.
+  if (clint) {
+    for (size_t i = 0; i < procs.size(); i++)
+      if (procs[i]->get_id() == id)
+        clint->update_timer(i);
+  }
 }
@@ -14,12 +14,12 @@
 #include "cfg.h"
 #include "debug_module.h"
 #include "devices.h"
+#include "linux_user.h"
 #include "log_file.h"
 #include "processor.h"
 #include "simif.h"
 
 #include <fesvr/htif.h>
-#include <fesvr/context.h>
 #include <vector>
 #include <string>
 #include <memory>
@@ -28,6 +28,34 @@
 class mmu_t;
 class remote_bitbang_t;
 
+// Watches target stores for the tohost word. Pages that hold it are kept out
+// of the store TLB, so every write to tohost rings the doorbell, which ends
+// the writing hart's quantum at once.
+class tohost_doorbell_t : public memtracer_t
+{
+ public:
+  tohost_doorbell_t() : addr(0), rung(false) {}
+  void set_addr(reg_t addr) { this->addr = addr; }
+  reg_t get_addr() const { return addr; }
+  bool interested_in_range(uint64_t begin, uint64_t end, access_type type);
+  void trace(uint64_t addr, size_t bytes, access_type type);
+  void clean_invalidate(uint64_t addr, size_t bytes, bool clean, bool inval) {}
+  bool urgent(uint64_t addr, size_t bytes, access_type type) { return hits(addr, bytes, type); }
+
+  // Return whether the doorbell has rung since it was last cleared.
+  bool has_rung() const { return rung; }
+  bool test_and_clear() { bool r = rung; rung = false; return r; }
+
+ private:
+  reg_t addr;
+  bool rung;
+
+  bool hits(uint64_t addr, size_t bytes, access_type type)
+  {
+    return type == STORE && addr < this->addr + 8 && addr + bytes > this->addr;
+  }
+};
+
 // this class encapsulates the processors and memory in a RISC-V machine.
 class sim_t : public htif_t, public simif_t
 {
@@ -65,6 +93,13 @@ public:
   processor_t* get_core(size_t i) { return procs.at(i); }
   unsigned nprocs() const { return procs.size(); }
 
+  // Record that [base, base+len) was loaded into memory before the
+  // simulation started, so that the program loader can warn about writes
+  // over it.
+  void mark_preloaded(reg_t base, size_t len) {
+    preloaded_ranges.push_back(std::make_pair(base, len));
+  }
+
   // Callback for processors to let the simulation know they were reset.
   void proc_reset(unsigned id);
 
@@ -76,12 +111,14 @@ private:
   mmu_t* debug_mmu;  // debug port into main memory
   std::vector<processor_t*> procs;
   std::pair<reg_t, reg_t> initrd_range;
+  std::vector<std::pair<reg_t, size_t>> preloaded_ranges;
   std::string dts;
   std::string dtb;
   std::string dtb_file;
   bool dtb_enabled;
   std::unique_ptr<rom_device_t> boot_rom;
   std::unique_ptr<clint_t> clint;
+  std::unique_ptr<linux_user_t> linux_user;
   bus_t bus;
   log_file_t log_file;
 
@@ -104,6 +141,13 @@ private:
   static const size_t CPU_HZ = 1000000000; // 1GHz CPU
   size_t current_step;
   size_t current_proc;
+  // The clock advances by the cycles the slowest hart took in each round of
+  // quanta, or by the instructions it retired without a timing model.
+  reg_t round_cycles;
+  reg_t turn_insns;
+  reg_t rtc_cycles;
+  size_t rtc_ticks();
+  tohost_doorbell_t tohost_doorbell;
   bool debug;
   bool histogram_enabled; // provide a histogram of PCs
   bool log;
@@ -111,8 +155,11 @@ private:
 
   // memory-mapped I/O routines
   char* addr_to_mem(reg_t addr);
+  char* addr_to_mem_for_write(reg_t addr);
   bool mmio_load(reg_t addr, size_t len, uint8_t* bytes);
   bool mmio_store(reg_t addr, size_t len, const uint8_t* bytes);
+  abstract_device_t* mmio_device(reg_t addr, reg_t* base, reg_t* end);
+  bool handle_user_trap(processor_t* proc, trap_t& t, reg_t epc);
   void make_dtb();
   void set_rom();
 
@@ -136,6 +183,7 @@ private:
   void interactive_pc(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_mem(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_str(const std::string& cmd, const std::vector<std::string>& args);
+  void interactive_pages(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_until(const std::string& cmd, const std::vector<std::string>& args, bool noisy);
   void interactive_until_silent(const std::string& cmd, const std::vector<std::string>& args);
   void interactive_until_noisy(const std::string& cmd, const std::vector<std::string>& args);
@@ -149,17 +197,19 @@ private:
   friend class debug_module_t;
 
   // htif
-  friend void sim_thread_main(void*);
-  void main();
-
-  context_t* host;
-  context_t target;
   void reset();
-  void idle();
+  void load_program();
+  char* contiguous_mem(reg_t addr, size_t len, bool write);
   void read_chunk(addr_t taddr, size_t len, void* dst);
   void write_chunk(addr_t taddr, size_t len, const void* src);
+  void clear_chunk(addr_t taddr, size_t len);
+  void* chunk_host_ptr(addr_t taddr, size_t len);
+  bool tohost_may_be_pending();
+  bool is_address_preloaded(addr_t taddr, size_t len);
   size_t chunk_align() { return 8; }
-  size_t chunk_max_size() { return 8; }
+  // RAM-backed chunks are copied a page at a time, so large chunks let
+  // program loading bypass the debug MMU entirely.
+  size_t chunk_max_size() { return 1 << 20; }
   void set_target_endianness(memif_endianness_t endianness);
   memif_endianness_t get_target_endianness() const;
 
@@ -5,17 +5,29 @@
 
 #include "decode.h"
 
+class abstract_device_t;
+class processor_t;
+class trap_t;
+
 // this is the interface to the simulator used by the processors and memory
 class simif_t
 {
 public:
   // should return NULL for MMIO addresses
   virtual char* addr_to_mem(reg_t addr) = 0;
+  // as addr_to_mem, for callers that will write through the result
+  virtual char* addr_to_mem_for_write(reg_t addr) { return addr_to_mem(addr); }
   // used for MMIO addresses
   virtual bool mmio_load(reg_t addr, size_t len, uint8_t* bytes) = 0;
   virtual bool mmio_store(reg_t addr, size_t len, const uint8_t* bytes) = 0;
+  // optionally resolve the device serving an MMIO address so that it can be
+  // cached; the device serves [*base, *end) and is accessed relative to *base.
+  virtual abstract_device_t* mmio_device(reg_t addr, reg_t* base, reg_t* end) { return NULL; }
   // Callback for processors to let the simulation know they were reset.
   virtual void proc_reset(unsigned id) = 0;
+  // optionally handle a trap taken from U-mode in place of the target's
+  // supervisor; returns true if the trap was handled.
+  virtual bool handle_user_trap(processor_t* proc, trap_t& t, reg_t epc) { return false; }
 
   virtual const char* get_symbol(uint64_t addr) = 0;
 
@@ -0,0 +1,288 @@
+// See LICENSE for license details.
+
+#include "timing_model.h"
+#include "cachesim.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+
+// The opcode() of a compressed instruction.
+#define RVC_OP(quadrant, funct3) ((quadrant) | (funct3) << 2)
+
+static void help()
+{
+  std::cerr << "Timing model configurations must be \"default\" or a" << std::endl;
+  std::cerr << "comma-separated list of key=value pairs, where the keys are" << std::endl;
+  std::cerr << "  alu, mul, div, fp, fdiv   latency of each instruction class" << std::endl;
+  std::cerr << "  load-use                  stall when a load result is used next" << std::endl;
+  std::cerr << "  mispredict                branch and jump mispredict penalty" << std::endl;
+  std::cerr << "  l1-miss, l2-miss, l3-miss penalty for a miss at each cache level" << std::endl;
+  std::cerr << "and the values are cycle counts." << std::endl;
+  exit(1);
+}
+
+timing_model_t::timing_model_t(const char* config, const char* name)
+  : name(name), load_use_penalty(1), mispredict_penalty(3),
+    cycles(0), cycles_taken(0), cycles_elapsed(0), instructions(0),
+    mispredicts(0), load_use_stalls(0), cache_stall_cycles(0),
+    load_rd(0), ras_top(0)
+{
+  class_latency[CLASS_ALU] = 1;
+  class_latency[CLASS_MUL] = 3;
+  class_latency[CLASS_DIV] = 20;
+  class_latency[CLASS_FP] = 4;
+  class_latency[CLASS_FDIV] = 20;
+  miss_penalty[0] = 10;
+  miss_penalty[1] = 100;
+  miss_penalty[2] = 100;
+
+  static const unsigned latency_ops[] = {
+    0x33, 0x3b, 0x53, 0x43, 0x47, 0x4b, 0x4f
+  };
+  static const unsigned load_ops[] = {
+    0x03, RVC_OP(0, 2), RVC_OP(0, 3), RVC_OP(2, 2), RVC_OP(2, 3)
+  };
+  static const unsigned control_ops[] = {
+    0x63, 0x67, 0x6f, RVC_OP(1, 5), RVC_OP(1, 6), RVC_OP(1, 7), RVC_OP(2, 4)
+  };
+  memset(op_info, 0, sizeof(op_info));
+  for (auto op : latency_ops)
+    op_info[op] |= OP_LATENCY;
+  for (auto op : load_ops)
+    op_info[op] |= OP_LOAD;
+  for (auto op : control_ops)
+    op_info[op] |= OP_CONTROL;
+
+  memset(bht, 0, sizeof(bht));
+  memset(btb, 0, sizeof(btb));
+  memset(ras, 0, sizeof(ras));
+
+  if (strcmp(config, "default") == 0)
+    return;
+
+  std::string rest = config;
+  while (!rest.empty()) {
+    size_t comma = rest.find(',');
+    std::string item = rest.substr(0, comma);
+    rest = comma == std::string::npos ? "" : rest.substr(comma + 1);
+
+    size_t eq = item.find('=');
+    if (eq == std::string::npos)
+      help();
+    std::string key = item.substr(0, eq);
+    char* end;
+    unsigned long val = strtoul(item.c_str() + eq + 1, &end, 0);
+    if (*end || eq + 1 == item.size())
+      help();
+
+    if (key == "alu") class_latency[CLASS_ALU] = val;
+    else if (key == "mul") class_latency[CLASS_MUL] = val;
+    else if (key == "div") class_latency[CLASS_DIV] = val;
+    else if (key == "fp") class_latency[CLASS_FP] = val;
+    else if (key == "fdiv") class_latency[CLASS_FDIV] = val;
+    else if (key == "load-use") load_use_penalty = val;
+    else if (key == "mispredict") mispredict_penalty = val;
+    else if (key == "l1-miss") miss_penalty[0] = val;
+    else if (key == "l2-miss") miss_penalty[1] = val;
+    else if (key == "l3-miss") miss_penalty[2] = val;
+    else help();
+  }
+}
+
+timing_model_t::~timing_model_t()
+{
+  print_stats();
+}
+
+void timing_model_t::add_cache(const cache_sim_t* cache, unsigned level)
+{
+  if (level < 1 || level > MAX_CACHE_LEVEL)
+    abort();
+  caches.push_back({cache, miss_penalty[level - 1], cache->misses()});
+}
+
+unsigned timing_model_t::latency(insn_t insn, insn_bits_t b, unsigned op)
+{
+  switch (op) {
+    case 0x33: // OP
+    case 0x3b: // OP-32
+      if ((b >> 25) == 1)
+        return class_latency[insn.rm() < 4 ? CLASS_MUL : CLASS_DIV];
+      break;
+    case 0x53: // OP-FP
+      return class_latency[(b >> 27) == 0x03 || (b >> 27) == 0x0b ? CLASS_FDIV : CLASS_FP];
+    case 0x43: case 0x47: case 0x4b: case 0x4f: // fused multiply-add
+      return class_latency[CLASS_FP];
+  }
+  return class_latency[CLASS_ALU];
+}
+
+// Integer loads only; FP loads rarely feed the next instruction.
+reg_t timing_model_t::load_dest(insn_t insn, unsigned op)
+{
+  switch (op) {
+    case 0x03:
+      return insn.rd();
+    case RVC_OP(0, 2): case RVC_OP(0, 3): // c.lw, c.ld
+      return insn.rvc_rs2s();
+    case RVC_OP(2, 2): case RVC_OP(2, 3): // c.lwsp, c.ldsp
+      return insn.rvc_rd();
+  }
+  return 0;
+}
+
+// Whether insn reads integer register r.
+bool timing_model_t::uses_reg(insn_t insn, insn_bits_t b, unsigned op, reg_t r)
+{
+  switch (op) {
+    case 0x23: case 0x33: case 0x3b: case 0x63: case 0x2f: // STORE, OP, OP-32, BRANCH, AMO
+      if (insn.rs2() == r)
+        return true;
+      // fall through
+    case 0x03: case 0x07: case 0x27: case 0x13: case 0x1b: case 0x67: // LOAD, LOAD-FP, STORE-FP, OP-IMM, OP-IMM-32, JALR
+      return insn.rs1() == r;
+    case 0x53: // OP-FP: moves and conversions from integer registers
+      return ((b >> 27) == 0x1a || (b >> 27) == 0x1e) && insn.rs1() == r;
+    case 0x73: // SYSTEM: CSR accesses that name a register
+      return (insn.rm() & 3) && !(insn.rm() & 4) && insn.rs1() == r;
+
+    case RVC_OP(0, 0): // c.addi4spn
+      return r == 2;
+    case RVC_OP(0, 6): case RVC_OP(0, 7): // c.sw, c.sd
+      if (insn.rvc_rs2s() == r)
+        return true;
+      // fall through
+    case RVC_OP(0, 1): case RVC_OP(0, 2): case RVC_OP(0, 3): case RVC_OP(0, 5):
+    case RVC_OP(1, 6): case RVC_OP(1, 7): // c.beqz, c.bnez
+      return insn.rvc_rs1s() == r;
+    case RVC_OP(1, 4): // c.srli, c.srai, c.andi, and register-register ALU ops
+      return insn.rvc_rs1s() == r ||
+             (((b >> 10) & 3) == 3 && insn.rvc_rs2s() == r);
+    case RVC_OP(1, 0): case RVC_OP(1, 1): case RVC_OP(2, 0): // c.addi, c.addiw, c.slli
+      return insn.rvc_rs1() == r;
+    case RVC_OP(1, 3): // c.addi16sp
+      return r == 2 && insn.rvc_rd() == 2;
+    case RVC_OP(2, 1): case RVC_OP(2, 2): case RVC_OP(2, 3): // loads from sp
+      return r == 2;
+    case RVC_OP(2, 4): // c.jr, c.mv, c.jalr, c.add
+      if (insn.rvc_rs2() == r)
+        return true;
+      return insn.rvc_rs1() == r && !((b & 0x1000) == 0 && insn.rvc_rs2() != 0);
+    case RVC_OP(2, 5): case RVC_OP(2, 6): case RVC_OP(2, 7): // stores to sp
+      return r == 2 || insn.rvc_rs2() == r;
+  }
+  return false;
+}
+
+void timing_model_t::predict(reg_t pc, insn_t insn, insn_bits_t b, unsigned op, reg_t npc)
+{
+  reg_t fallthrough = pc + insn_length(b);
+  bool branch = false, indirect = false;
+  reg_t rd = 0, rs1 = 0;
+  switch (op) {
+    case 0x63: case RVC_OP(1, 6): case RVC_OP(1, 7): // conditional branches
+      branch = true;
+      break;
+    case 0x6f: // jal
+      rd = insn.rd();
+      break;
+    case RVC_OP(1, 5): // c.j
+      break;
+    case 0x67: // jalr
+      indirect = true;
+      rd = insn.rd();
+      rs1 = insn.rs1();
+      break;
+    case RVC_OP(2, 4):
+      if (insn.rvc_rs2() != 0 || insn.rvc_rs1() == 0)
+        return;
+      // c.jr, c.jalr
+      indirect = true;
+      rd = (b & 0x1000) ? 1 : 0;
+      rs1 = insn.rvc_rs1();
+      break;
+    default:
+      return;
+  }
+
+  size_t idx = (pc >> 1) % BHT_ENTRIES;
+  bool correct = true;
+  if (branch) {
+    bool taken = npc != fallthrough;
+    correct = (bht[idx] >= 2) == taken;
+    if (taken && bht[idx] < 3)
+      bht[idx]++;
+    else if (!taken && bht[idx] > 0)
+      bht[idx]--;
+  } else {
+    bool link = rd == 1 || rd == 5;
+    if (indirect && !link && (rs1 == 1 || rs1 == 5)) {
+      // a return: predicted by the return-address stack
+      correct = ras[ras_top] == npc;
+      ras_top = (ras_top + RAS_ENTRIES - 1) % RAS_ENTRIES;
+    } else if (indirect) {
+      correct = btb[idx] == npc;
+      btb[idx] = npc;
+    }
+    if (link) {
+      ras_top = (ras_top + 1) % RAS_ENTRIES;
+      ras[ras_top] = fallthrough;
+    }
+  }
+
+  if (!correct) {
+    cycles += mispredict_penalty;
+    mispredicts++;
+  }
+}
+
+void timing_model_t::sync_caches()
+{
+  for (auto& c : caches)
+    c.last_misses = c.cache->misses();
+}
+
+reg_t timing_model_t::take_cycles()
+{
+  for (auto& c : caches) {
+    uint64_t misses = c.cache->misses();
+    uint64_t stall = (misses - c.last_misses) * c.penalty;
+    cycles += stall;
+    cache_stall_cycles += stall;
+    c.last_misses = misses;
+  }
+
+  reg_t res = cycles - cycles_taken;
+  cycles_taken = cycles;
+  return res;
+}
+
+reg_t timing_model_t::take_elapsed()
+{
+  reg_t res = cycles - cycles_elapsed;
+  cycles_elapsed = cycles;
+  return res;
+}
+
+void timing_model_t::print_stats()
+{
+  if (instructions == 0)
+    return;
+
+  float cpi = float(cycles) / instructions;
+
+  std::cout << std::setprecision(3) << std::fixed;
+  std::cout << name << " ";
+  std::cout << "Cycles:                " << cycles << std::endl;
+  std::cout << name << " ";
+  std::cout << "Instructions:          " << instructions << std::endl;
+  std::cout << name << " ";
+  std::cout << "CPI:                   " << cpi << std::endl;
+  std::cout << name << " ";
+  std::cout << "Mispredicts:           " << mispredicts << std::endl;
+  std::cout << name << " ";
+  std::cout << "Load-Use Stalls:       " << load_use_stalls << std::endl;
+  std::cout << name << " ";
+  std::cout << "Cache Stall Cycles:    " << cache_stall_cycles << std::endl;
+}
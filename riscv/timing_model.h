@@ -0,0 +1,116 @@
+// See LICENSE for license details.
+#ifndef _RISCV_TIMING_MODEL_H
+#define _RISCV_TIMING_MODEL_H
+
+#include "decode.h"
+#include <string>
+#include <vector>
+
+class cache_sim_t;
+
+// A first-order model of a single-issue, blocking in-order pipeline, used
+// to drive mcycle instead of assuming a CPI of 1. Each retired instruction
+// costs the latency of its class, plus a penalty if it uses the result of
+// the load just before it, plus a penalty if its branch or jump target was
+// mispredicted. Misses in the attached cache models add their penalties.
+class timing_model_t
+{
+ public:
+  // config is a comma-separated list of key=value pairs overriding the
+  // defaults, or "default".
+  timing_model_t(const char* config, const char* name);
+  ~timing_model_t();
+
+  // Charge misses in cache to this hart. level is 1 for L1 caches.
+  void add_cache(const cache_sim_t* cache, unsigned level);
+
+  // Account for one retired instruction at pc; npc is the next PC.
+  void retire(reg_t pc, insn_t insn, reg_t npc)
+  {
+    insn_bits_t b = insn.bits();
+    unsigned op = opcode(b);
+    uint8_t info = op_info[op];
+
+    cycles += (info & OP_LATENCY) ? latency(insn, b, op) : class_latency[CLASS_ALU];
+    if (unlikely(load_rd != 0) && uses_reg(insn, b, op, load_rd)) {
+      cycles += load_use_penalty;
+      load_use_stalls++;
+    }
+    load_rd = (info & OP_LOAD) ? load_dest(insn, op) : 0;
+    if (info & OP_CONTROL)
+      predict(pc, insn, b, op, npc);
+    instructions++;
+  }
+
+  // Forget cache misses that were not caused by this hart, such as those
+  // other harts made in shared caches since this hart last ran.
+  void sync_caches();
+  // Cycles elapsed since the last call, including cache miss penalties.
+  reg_t take_cycles();
+  // Cycles elapsed since the last call, for advancing the real-time clock.
+  reg_t take_elapsed();
+
+  void print_stats();
+
+ private:
+  enum {
+    CLASS_ALU,
+    CLASS_MUL,
+    CLASS_DIV,
+    CLASS_FP,
+    CLASS_FDIV,
+    NUM_CLASSES
+  };
+  // Instructions are classified by their major opcode, or for compressed
+  // instructions by quadrant and funct3. The two never collide, because the
+  // low two bits of a 32-bit opcode are always set.
+  static unsigned opcode(insn_bits_t b)
+  {
+    return (b & 3) == 3 ? b & 0x7f : (b & 3) | ((b >> 13) & 7) << 2;
+  }
+  enum {
+    OP_LATENCY = 1, // may take longer than an ALU operation
+    OP_LOAD = 2,    // may be an integer load
+    OP_CONTROL = 4  // may be a branch or jump
+  };
+  uint8_t op_info[128];
+
+  static const size_t MAX_CACHE_LEVEL = 3;
+  static const size_t BHT_ENTRIES = 1024;
+  static const size_t RAS_ENTRIES = 8;
+
+  std::string name;
+  unsigned class_latency[NUM_CLASSES];
+  unsigned load_use_penalty;
+  unsigned mispredict_penalty;
+  unsigned miss_penalty[MAX_CACHE_LEVEL];
+
+  struct cache_counter_t {
+    const cache_sim_t* cache;
+    unsigned penalty;
+    uint64_t last_misses;
+  };
+  std::vector<cache_counter_t> caches;
+
+  uint64_t cycles;
+  uint64_t cycles_taken;
+  uint64_t cycles_elapsed;
+  uint64_t instructions;
+  uint64_t mispredicts;
+  uint64_t load_use_stalls;
+  uint64_t cache_stall_cycles;
+
+  reg_t load_rd; // destination of the previous instruction if a load, else 0
+
+  uint8_t bht[BHT_ENTRIES]; // 2-bit saturating counters
+  reg_t btb[BHT_ENTRIES];   // last target of each indirect jump
+  reg_t ras[RAS_ENTRIES];
+  size_t ras_top;
+
+  unsigned latency(insn_t insn, insn_bits_t b, unsigned op);
+  static reg_t load_dest(insn_t insn, unsigned op);
+  static bool uses_reg(insn_t insn, insn_bits_t b, unsigned op, reg_t r);
+  void predict(reg_t pc, insn_t insn, insn_bits_t b, unsigned op, reg_t npc);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "debug_defines.h"
 #include "processor.h"
+#include "mmu.h"
 #include "triggers.h"
 
 namespace triggers {
@@ -108,6 +109,39 @@ bool mcontrol_t::simple_match(unsigned xlen, reg_t value) const {
   assert(0);
 }
 
+bool mcontrol_t::address_range(reg_t *lo, reg_t *hi) const {
+  if (select)
+    return false;
+
+  switch (match) {
+    case triggers::mcontrol_t::MATCH_EQUAL:
+      *lo = *hi = tdata2;
+      return true;
+    case triggers::mcontrol_t::MATCH_NAPOT:
+      {
+        // simple_match computes the mask with an int shift, so only resolve
+        // ranges for which that shift is well defined.
+        if (cto(tdata2) + 1 >= 31)
+          return false;
+        reg_t mask = ~((1 << (cto(tdata2)+1)) - 1);
+        *lo = tdata2 & mask;
+        *hi = *lo | ~mask;
+        return true;
+      }
+    case triggers::mcontrol_t::MATCH_GE:
+      *lo = tdata2;
+      *hi = -1;
+      return true;
+    case triggers::mcontrol_t::MATCH_LT:
+      // An empty range is reported as lo > hi.
+      *lo = tdata2 == 0 ? 1 : 0;
+      *hi = tdata2 == 0 ? 0 : tdata2 - 1;
+      return true;
+    default:
+      return false;
+  }
+}
+
 match_result_t mcontrol_t::memory_access_match(processor_t * const proc, operation_t operation, reg_t address, reg_t data) {
   state_t * const state = proc->get_state();
   if ((operation == triggers::OPERATION_EXECUTE && !execute_bit) ||
@@ -196,6 +230,7 @@ reg_t module_t::tdata1_read(const processor_t * const proc, unsigned index) cons
 bool module_t::tdata1_write(processor_t * const proc, unsigned index, const reg_t val) noexcept
 {
   bool result = triggers[index]->tdata1_write(proc, val);
+  update_interest();
   proc->trigger_updated(triggers);
   return result;
 }
@@ -208,9 +243,49 @@ reg_t module_t::tdata2_read(const processor_t * const proc, unsigned index) cons
 bool module_t::tdata2_write(processor_t * const proc, unsigned index, const reg_t val) noexcept
 {
   bool result = triggers[index]->tdata2_write(proc, val);
+  update_interest();
   proc->trigger_updated(triggers);
   return result;
 }
 
+void module_t::update_interest()
+{
+  for (auto &ranges : interest)
+    ranges.clear();
+
+  // Chained triggers only fire if every trigger in the chain matches, so the
+  // union of the individual ranges is a superset of what can fire.
+  for (auto trigger : triggers) {
+    reg_t lo, hi;
+    std::pair<reg_t, reg_t> pages(0, reg_t(-1) >> PGSHIFT);
+    if (trigger->address_range(&lo, &hi)) {
+      if (lo > hi)
+        continue;
+      pages = std::make_pair(lo >> PGSHIFT, hi >> PGSHIFT);
+    }
+
+    if (trigger->execute())
+      interest[OPERATION_EXECUTE].push_back(pages);
+    if (trigger->store())
+      interest[OPERATION_STORE].push_back(pages);
+    if (trigger->load())
+      interest[OPERATION_LOAD].push_back(pages);
+  }
+}
+
+bool module_t::page_may_match(operation_t operation, reg_t address) const
+{
+  // memory_access_match compares only the low 32 bits on RV32.
+  if (proc->get_xlen() == 32)
+    address &= 0xffffffff;
+
+  reg_t vpn = address >> PGSHIFT;
+  for (auto &range : interest[operation])
+    if (vpn >= range.first && vpn <= range.second)
+      return true;
+
+  return false;
+}
+
 
 };
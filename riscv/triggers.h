@@ -55,6 +55,10 @@ public:
   virtual bool store() const { return false; }
   virtual bool load() const { return false; }
 
+  // Report the inclusive range of addresses this trigger can match in
+  // [*lo, *hi]. Returns false if the trigger may match any address.
+  virtual bool address_range(reg_t *lo, reg_t *hi) const { return false; }
+
 public:
   bool dmode;
   action_t action;
@@ -90,6 +94,8 @@ public:
   virtual bool store() const override { return store_bit; }
   virtual bool load() const override { return load_bit; }
 
+  virtual bool address_range(reg_t *lo, reg_t *hi) const override;
+
   virtual match_result_t memory_access_match(processor_t * const proc,
       operation_t operation, reg_t address, reg_t data) override;
 
@@ -125,9 +131,19 @@ public:
   reg_t tdata2_read(const processor_t * const proc, unsigned index) const noexcept;
   bool tdata2_write(processor_t * const proc, unsigned index, const reg_t val) noexcept;
 
+  // Conservatively determine whether an access of the given type to the
+  // page containing address could cause any trigger to fire.
+  bool page_may_match(operation_t operation, reg_t address) const;
+
   processor_t *proc;
 private:
+  void update_interest();
+
   std::vector<trigger_t *> triggers;
+
+  // Per-operation list of inclusive page-number ranges that the armed
+  // triggers can match, rebuilt whenever a trigger is written.
+  std::vector<std::pair<reg_t, reg_t>> interest[3];
 };
 
 };
@@ -3,6 +3,9 @@
 #ifndef _RISCV_V_EXT_MACROS_H
 #define _RISCV_V_EXT_MACROS_H
 
+#include <cfenv>
+#include <cmath>
+
 //
 // vector: masking skip helper
 //
@@ -10,16 +13,49 @@
   const int midx = i / 64; \
   const int mpos = i % 64;
 
+// Word n of mask register reg. Where the register file holds mask words
+// in order, it is indexed directly rather than through elt.
+#if defined(WORDS_BIGENDIAN) || defined(RISCV_ENABLE_COMMITLOG)
+#define VI_MASK_WORD(reg, n, is_write) P.VU.elt<uint64_t>(reg, n, is_write)
+#else
+#define VI_MASK_WORD(reg, n, is_write) (P.VU.elt_group<uint64_t>(reg)[n])
+#endif
+
+// The bits of mask word n that belong to elements [start, end).
+static inline uint64_t mask_word_range(uint64_t n, uint64_t start, uint64_t end)
+{
+  const uint64_t lo = start > n * 64 ? start - n * 64 : 0;
+  const uint64_t hi = end > n * 64 ? end - n * 64 : 0;
+  if (lo >= 64 || lo >= hi)
+    return 0;
+  return (hi >= 64 ? UINT64_MAX : (UINT64_C(1) << hi) - 1) & (UINT64_MAX << lo);
+}
+
 #define VI_LOOP_ELEMENT_SKIP(BODY) \
   VI_MASK_VARS \
   if (insn.v_vm() == 0) { \
     BODY; \
-    bool skip = ((P.VU.elt<uint64_t>(0, midx) >> mpos) & 0x1) == 0; \
+    bool skip = ((VI_MASK_WORD(0, midx, false) >> mpos) & 0x1) == 0; \
     if (skip) { \
         continue; \
     } \
   }
 
+// Loops over the active elements i in [vstart, vl). v0 is read a word at
+// a time, and masked-off elements are stepped over rather than tested.
+#define VI_ACTIVE_LOOP_BASE \
+  for (reg_t midx = vstart / 64; midx * 64 < vl; ++midx) { \
+    uint64_t active = mask_word_range(midx, vstart, vl); \
+    if (insn.v_vm() == 0) \
+      active &= VI_MASK_WORD(0, midx, false); \
+    for (; active; active &= active - 1) { \
+      const int mpos = ctz(active); \
+      const reg_t i = midx * 64 + mpos;
+
+#define VI_ACTIVE_LOOP_END \
+    } \
+  }
+
 #define VI_ELEMENT_SKIP(inx) \
   if (inx >= vl) { \
     continue; \
@@ -205,7 +241,53 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 //
 // vector: loop header and end helper
 //
-#define VI_GENERAL_LOOP_BASE \
+// Register groups are contiguous in the register file, so on little-endian
+// hosts element i of a group is element i of a flat array starting at the
+// group's first register. Commit-logging builds keep going through elt(),
+// which records each register written.
+#define VI_GROUP_VARS \
+  char *rd_group = P.VU.elt_group<char>(rd_num); \
+  char *rs1_group = P.VU.elt_group<char>(rs1_num); \
+  char *rs2_group = P.VU.elt_group<char>(rs2_num);
+
+#if defined(WORDS_BIGENDIAN) || defined(RISCV_ENABLE_COMMITLOG)
+#define VI_GROUP_ELT_AT(type, reg, n, is_write) P.VU.elt<type>(reg##_num, n, is_write)
+#define VI_HOST_SIMD 0
+#else
+#define VI_GROUP_ELT_AT(type, reg, n, is_write) (((type*)reg##_group)[n])
+#define VI_HOST_SIMD 1
+#endif
+#define VI_GROUP_ELT(type, reg, is_write) VI_GROUP_ELT_AT(type, reg, i, is_write)
+
+// Moves n elements of the current SEW, from element src of the group at
+// src_reg to element dst of the group at dst_reg. Overlapping ranges must
+// have dst <= src, as slide-downs do.
+#if VI_HOST_SIMD
+#define VI_ELT_MOVE(dst_reg, dst, src_reg, src, n) \
+  memmove(P.VU.elt_group<char>(dst_reg) + (dst) * (P.VU.vsew >> 3), \
+          P.VU.elt_group<char>(src_reg) + (src) * (P.VU.vsew >> 3), \
+          (n) * (P.VU.vsew >> 3))
+#else
+#define VI_ELT_MOVE(dst_reg, dst, src_reg, src, n) \
+  for (reg_t k = 0; k < (n); ++k) { \
+    switch (P.VU.vsew) { \
+    case e8: \
+      P.VU.elt<uint8_t>(dst_reg, (dst) + k, true) = P.VU.elt<uint8_t>(src_reg, (src) + k); \
+      break; \
+    case e16: \
+      P.VU.elt<uint16_t>(dst_reg, (dst) + k, true) = P.VU.elt<uint16_t>(src_reg, (src) + k); \
+      break; \
+    case e32: \
+      P.VU.elt<uint32_t>(dst_reg, (dst) + k, true) = P.VU.elt<uint32_t>(src_reg, (src) + k); \
+      break; \
+    default: \
+      P.VU.elt<uint64_t>(dst_reg, (dst) + k, true) = P.VU.elt<uint64_t>(src_reg, (src) + k); \
+      break; \
+    } \
+  }
+#endif
+
+#define VI_GENERAL_LOOP_VARS \
   require(P.VU.vsew >= e8 && P.VU.vsew <= e64); \
   require_vector(true); \
   reg_t vl = P.VU.vl->read(); \
@@ -213,6 +295,10 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   reg_t rd_num = insn.rd(); \
   reg_t rs1_num = insn.rs1(); \
   reg_t rs2_num = insn.rs2(); \
+  VI_GROUP_VARS
+
+#define VI_GENERAL_LOOP_BASE \
+  VI_GENERAL_LOOP_VARS \
   for (reg_t i = P.VU.vstart->read(); i < vl; ++i) {
 
 #define VI_LOOP_BASE \
@@ -233,7 +319,7 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 #define VI_LOOP_CARRY_BASE \
   VI_GENERAL_LOOP_BASE \
   VI_MASK_VARS \
-  auto v0 = P.VU.elt<uint64_t>(0, midx); \
+  auto v0 = VI_MASK_WORD(0, midx, false); \
   const uint64_t mmask = UINT64_C(1) << mpos; \
   const uint128_t op_mask = (UINT64_MAX >> (64 - sew)); \
   uint64_t carry = insn.v_vm() == 0 ? (v0 >> mpos) & 0x1 : 0; \
@@ -247,22 +333,19 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 #define VI_LOOP_WITH_CARRY_BASE \
   VI_GENERAL_LOOP_BASE \
   VI_MASK_VARS \
-  auto &v0 = P.VU.elt<uint64_t>(0, midx); \
+  auto &v0 = VI_MASK_WORD(0, midx, false); \
   const uint128_t op_mask = (UINT64_MAX >> (64 - sew)); \
   uint64_t carry = (v0 >> mpos) & 0x1;
 
 #define VI_LOOP_CMP_BASE \
-  require(P.VU.vsew >= e8 && P.VU.vsew <= e64); \
-  require_vector(true); \
-  reg_t vl = P.VU.vl->read(); \
-  reg_t sew = P.VU.vsew; \
-  reg_t rd_num = insn.rd(); \
-  reg_t rs1_num = insn.rs1(); \
-  reg_t rs2_num = insn.rs2(); \
+  VI_GENERAL_LOOP_VARS \
   for (reg_t i = P.VU.vstart->read(); i < vl; ++i) { \
+    VI_LOOP_CMP_ELEMENT
+
+#define VI_LOOP_CMP_ELEMENT \
     VI_LOOP_ELEMENT_SKIP(); \
     uint64_t mmask = UINT64_C(1) << mpos; \
-    uint64_t &vdi = P.VU.elt<uint64_t>(insn.rd(), midx, true); \
+    uint64_t &vdi = VI_GROUP_ELT_AT(uint64_t, rd, midx, true); \
     uint64_t res = 0;
 
 #define VI_LOOP_CMP_END \
@@ -274,14 +357,13 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   require(P.VU.vsew <= e64); \
   require_vector(true); \
   reg_t vl = P.VU.vl->read(); \
-  for (reg_t i = P.VU.vstart->read(); i < vl; ++i) { \
-    int midx = i / 64; \
-    int mpos = i % 64; \
-    uint64_t mmask = UINT64_C(1) << mpos; \
-    uint64_t vs2 = P.VU.elt<uint64_t>(insn.rs2(), midx); \
-    uint64_t vs1 = P.VU.elt<uint64_t>(insn.rs1(), midx); \
-    uint64_t &res = P.VU.elt<uint64_t>(insn.rd(), midx, true); \
-    res = (res & ~mmask) | ((op) & (1ULL << mpos)); \
+  reg_t vstart = P.VU.vstart->read(); \
+  for (reg_t midx = vstart / 64; midx * 64 < vl; ++midx) { \
+    uint64_t mmask = mask_word_range(midx, vstart, vl); \
+    uint64_t vs2 = VI_MASK_WORD(insn.rs2(), midx, false); \
+    uint64_t vs1 = VI_MASK_WORD(insn.rs1(), midx, false); \
+    uint64_t &res = VI_MASK_WORD(insn.rd(), midx, true); \
+    res = (res & ~mmask) | ((op) & mmask); \
   } \
   P.VU.vstart->write(0);
 
@@ -319,78 +401,78 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 // vector: integer and masking operand access helper
 //
 #define VXI_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
-  type_sew_t<x>::type vs1 = P.VU.elt<type_sew_t<x>::type>(rs1_num, i); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i); \
+  type_sew_t<x>::type &vd = VI_GROUP_ELT(type_sew_t<x>::type, rd, true); \
+  type_sew_t<x>::type vs1 = VI_GROUP_ELT(type_sew_t<x>::type, rs1, false); \
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false); \
   type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1; \
   type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5();
 
 #define VV_U_PARAMS(x) \
-  type_usew_t<x>::type &vd = P.VU.elt<type_usew_t<x>::type>(rd_num, i, true); \
-  type_usew_t<x>::type vs1 = P.VU.elt<type_usew_t<x>::type>(rs1_num, i); \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type &vd = VI_GROUP_ELT(type_usew_t<x>::type, rd, true); \
+  type_usew_t<x>::type vs1 = VI_GROUP_ELT(type_usew_t<x>::type, rs1, false); \
+  type_usew_t<x>::type vs2 = VI_GROUP_ELT(type_usew_t<x>::type, rs2, false);
 
 #define VX_U_PARAMS(x) \
-  type_usew_t<x>::type &vd = P.VU.elt<type_usew_t<x>::type>(rd_num, i, true); \
+  type_usew_t<x>::type &vd = VI_GROUP_ELT(type_usew_t<x>::type, rd, true); \
   type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1; \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs2 = VI_GROUP_ELT(type_usew_t<x>::type, rs2, false);
 
 #define VI_U_PARAMS(x) \
-  type_usew_t<x>::type &vd = P.VU.elt<type_usew_t<x>::type>(rd_num, i, true); \
+  type_usew_t<x>::type &vd = VI_GROUP_ELT(type_usew_t<x>::type, rd, true); \
   type_usew_t<x>::type zimm5 = (type_usew_t<x>::type)insn.v_zimm5(); \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs2 = VI_GROUP_ELT(type_usew_t<x>::type, rs2, false);
 
 #define VV_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
-  type_sew_t<x>::type vs1 = P.VU.elt<type_sew_t<x>::type>(rs1_num, i); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type &vd = VI_GROUP_ELT(type_sew_t<x>::type, rd, true); \
+  type_sew_t<x>::type vs1 = VI_GROUP_ELT(type_sew_t<x>::type, rs1, false); \
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false);
 
 #define VX_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
+  type_sew_t<x>::type &vd = VI_GROUP_ELT(type_sew_t<x>::type, rd, true); \
   type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1; \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false);
 
 #define VI_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
+  type_sew_t<x>::type &vd = VI_GROUP_ELT(type_sew_t<x>::type, rd, true); \
   type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5(); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false);
 
 #define XV_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
+  type_sew_t<x>::type &vd = VI_GROUP_ELT(type_sew_t<x>::type, rd, true); \
   type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, RS1);
 
 #define VV_SU_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
-  type_usew_t<x>::type vs1 = P.VU.elt<type_usew_t<x>::type>(rs1_num, i); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type &vd = VI_GROUP_ELT(type_sew_t<x>::type, rd, true); \
+  type_usew_t<x>::type vs1 = VI_GROUP_ELT(type_usew_t<x>::type, rs1, false); \
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false);
 
 #define VX_SU_PARAMS(x) \
-  type_sew_t<x>::type &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
+  type_sew_t<x>::type &vd = VI_GROUP_ELT(type_sew_t<x>::type, rd, true); \
   type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1; \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false);
 
 #define VV_UCMP_PARAMS(x) \
-  type_usew_t<x>::type vs1 = P.VU.elt<type_usew_t<x>::type>(rs1_num, i); \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs1 = VI_GROUP_ELT(type_usew_t<x>::type, rs1, false); \
+  type_usew_t<x>::type vs2 = VI_GROUP_ELT(type_usew_t<x>::type, rs2, false);
 
 #define VX_UCMP_PARAMS(x) \
   type_usew_t<x>::type rs1 = (type_usew_t<x>::type)RS1; \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs2 = VI_GROUP_ELT(type_usew_t<x>::type, rs2, false);
 
 #define VI_UCMP_PARAMS(x) \
-  type_usew_t<x>::type vs2 = P.VU.elt<type_usew_t<x>::type>(rs2_num, i);
+  type_usew_t<x>::type vs2 = VI_GROUP_ELT(type_usew_t<x>::type, rs2, false);
 
 #define VV_CMP_PARAMS(x) \
-  type_sew_t<x>::type vs1 = P.VU.elt<type_sew_t<x>::type>(rs1_num, i); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs1 = VI_GROUP_ELT(type_sew_t<x>::type, rs1, false); \
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false);
 
 #define VX_CMP_PARAMS(x) \
   type_sew_t<x>::type rs1 = (type_sew_t<x>::type)RS1; \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false);
 
 #define VI_CMP_PARAMS(x) \
   type_sew_t<x>::type simm5 = (type_sew_t<x>::type)insn.v_simm5(); \
-  type_sew_t<x>::type vs2 = P.VU.elt<type_sew_t<x>::type>(rs2_num, i);
+  type_sew_t<x>::type vs2 = VI_GROUP_ELT(type_sew_t<x>::type, rs2, false);
 
 #define VI_XI_SLIDEDOWN_PARAMS(x, off) \
   auto &vd = P.VU.elt<type_sew_t<x>::type>(rd_num, i, true); \
@@ -484,10 +566,40 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
   }
 
 // comparision result to masking register
+//
+// Results are gathered into a local copy of each vd word, which is
+// stored once its 64 elements are done.
+#define VI_LOOP_CMP_SEW(x, PARAMS, BODY) \
+  for (reg_t midx = vstart / 64; midx * 64 < vl; ++midx) { \
+    uint64_t &vd_word = VI_GROUP_ELT_AT(uint64_t, rd, midx, true); \
+    uint64_t active = mask_word_range(midx, vstart, vl); \
+    if (insn.v_vm() == 0) \
+      active &= VI_MASK_WORD(0, midx, false); \
+    uint64_t vdi = vd_word & ~active; \
+    for (uint64_t m = active; m; m &= m - 1) { \
+      const int mpos = ctz(m); \
+      const reg_t i = midx * 64 + mpos; \
+      uint64_t res = 0; \
+      PARAMS(x); \
+      BODY; \
+      vdi |= ((res) & 0x1) << mpos; \
+    } \
+    vd_word = vdi; \
+  }
+
 #define VI_LOOP_CMP_BODY(PARAMS, BODY) \
-  VI_LOOP_CMP_BASE \
-  INSNS_BASE(PARAMS, BODY) \
-  VI_LOOP_CMP_END
+  VI_GENERAL_LOOP_VARS \
+  reg_t vstart = P.VU.vstart->read(); \
+  if (sew == e8) { \
+    VI_LOOP_CMP_SEW(e8, PARAMS, BODY) \
+  } else if (sew == e16) { \
+    VI_LOOP_CMP_SEW(e16, PARAMS, BODY) \
+  } else if (sew == e32) { \
+    VI_LOOP_CMP_SEW(e32, PARAMS, BODY) \
+  } else if (sew == e64) { \
+    VI_LOOP_CMP_SEW(e64, PARAMS, BODY) \
+  } \
+  P.VU.vstart->write(0);
 
 #define VI_VV_LOOP_CMP(BODY) \
   VI_CHECK_MSS(true); \
@@ -658,150 +770,155 @@ static inline bool is_aligned(const unsigned val, const unsigned pos)
 
 
 // genearl VXI signed/unsigned loop
-#define VI_VV_ULOOP(BODY) \
-  VI_CHECK_SSS(true) \
-  VI_LOOP_BASE \
+//
+// The SEW dispatch is hoisted out of the element loop, and unmasked
+// instructions skip the mask test altogether.
+#define VI_SEW_ELEMENT_LOOP(x, PARAMS, BODY) \
+  if (insn.v_vm() == 1) { \
+    for (reg_t i = vstart; i < vl; ++i) { \
+      PARAMS(x); \
+      BODY; \
+    } \
+  } else { \
+    VI_ACTIVE_LOOP_BASE \
+      PARAMS(x); \
+      BODY; \
+    VI_ACTIVE_LOOP_END \
+  }
+
+#define VI_SEW_LOOP(PARAMS, BODY) \
+  VI_GENERAL_LOOP_VARS \
+  reg_t vstart = P.VU.vstart->read(); \
   if (sew == e8) { \
-    VV_U_PARAMS(e8); \
-    BODY; \
+    VI_SEW_ELEMENT_LOOP(e8, PARAMS, BODY) \
   } else if (sew == e16) { \
-    VV_U_PARAMS(e16); \
-    BODY; \
+    VI_SEW_ELEMENT_LOOP(e16, PARAMS, BODY) \
   } else if (sew == e32) { \
-    VV_U_PARAMS(e32); \
-    BODY; \
+    VI_SEW_ELEMENT_LOOP(e32, PARAMS, BODY) \
   } else if (sew == e64) { \
-    VV_U_PARAMS(e64); \
-    BODY; \
+    VI_SEW_ELEMENT_LOOP(e64, PARAMS, BODY) \
   } \
-  VI_LOOP_END 
+  P.VU.vstart->write(0);
 
-#define VI_VV_LOOP(BODY) \
-  VI_CHECK_SSS(true) \
-  VI_LOOP_BASE \
+// For bodies that are equally valid on GCC vector types, unmasked elements
+// are processed a host SIMD register at a time, and any leftover elements
+// by the scalar loop. Within the SIMD body, sew is a constant of the
+// element type, so expressions such as (vs1 & (sew - 1)) stay vectors.
+#define VI_SIMD_BYTES 16
+
+#if VI_HOST_SIMD
+#define VI_SIMD_LOAD(v, reg) \
+  simd_vec_t v; \
+  memcpy(&v, reg##_group + i * sizeof(simd_elt_t), sizeof(v));
+
+#define VI_SIMD_ELEMENT_LOOP(elt_type, DECLS, BODY) \
+  if (insn.v_vm() == 1) { \
+    typedef elt_type simd_elt_t; \
+    typedef simd_elt_t simd_vec_t __attribute__((vector_size(VI_SIMD_BYTES))); \
+    constexpr simd_elt_t sew = sizeof(simd_elt_t) * 8; \
+    const reg_t lanes = VI_SIMD_BYTES / sizeof(simd_elt_t); \
+    for (; vstart + lanes <= vl; vstart += lanes) { \
+      const reg_t i = vstart; \
+      VI_SIMD_LOAD(vd, rd) \
+      DECLS \
+      BODY; \
+      memcpy(rd_group + i * sizeof(simd_elt_t), &vd, sizeof(vd)); \
+    } \
+  }
+#else
+#define VI_SIMD_ELEMENT_LOOP(elt_type, DECLS, BODY)
+#endif
+
+#define VV_SIMD_DECLS \
+  VI_SIMD_LOAD(vs1, rs1) \
+  VI_SIMD_LOAD(vs2, rs2)
+
+#define VX_SIMD_DECLS \
+  simd_elt_t rs1 = (simd_elt_t)RS1; \
+  VI_SIMD_LOAD(vs2, rs2)
+
+#define VI_SIMD_DECLS \
+  simd_elt_t simm5 = (simd_elt_t)insn.v_simm5(); \
+  VI_SIMD_LOAD(vs2, rs2)
+
+#define VI_U_SIMD_DECLS \
+  simd_elt_t zimm5 = (simd_elt_t)insn.v_zimm5(); \
+  VI_SIMD_LOAD(vs2, rs2)
+
+#define VI_SIMD_SEW_LOOP(TYPE, DECLS, PARAMS, BODY) \
+  VI_GENERAL_LOOP_VARS \
+  reg_t vstart = P.VU.vstart->read(); \
   if (sew == e8) { \
-    VV_PARAMS(e8); \
-    BODY; \
+    VI_SIMD_ELEMENT_LOOP(TYPE<e8>::type, DECLS, BODY) \
+    VI_SEW_ELEMENT_LOOP(e8, PARAMS, BODY) \
   } else if (sew == e16) { \
-    VV_PARAMS(e16); \
-    BODY; \
+    VI_SIMD_ELEMENT_LOOP(TYPE<e16>::type, DECLS, BODY) \
+    VI_SEW_ELEMENT_LOOP(e16, PARAMS, BODY) \
   } else if (sew == e32) { \
-    VV_PARAMS(e32); \
-    BODY; \
+    VI_SIMD_ELEMENT_LOOP(TYPE<e32>::type, DECLS, BODY) \
+    VI_SEW_ELEMENT_LOOP(e32, PARAMS, BODY) \
   } else if (sew == e64) { \
-    VV_PARAMS(e64); \
-    BODY; \
+    VI_SIMD_ELEMENT_LOOP(TYPE<e64>::type, DECLS, BODY) \
+    VI_SEW_ELEMENT_LOOP(e64, PARAMS, BODY) \
   } \
-  VI_LOOP_END 
+  P.VU.vstart->write(0);
+
+#define VI_VV_ULOOP(BODY) \
+  VI_CHECK_SSS(true) \
+  VI_SEW_LOOP(VV_U_PARAMS, BODY)
+
+#define VI_VV_LOOP(BODY) \
+  VI_CHECK_SSS(true) \
+  VI_SEW_LOOP(VV_PARAMS, BODY)
 
 #define VI_VX_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VX_U_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VX_U_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VX_U_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VX_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VX_U_PARAMS, BODY)
 
 #define VI_VX_LOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VX_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VX_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VX_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VX_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VX_PARAMS, BODY)
 
 #define VI_VI_ULOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VI_U_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VI_U_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VI_U_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VI_U_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VI_U_PARAMS, BODY)
 
 #define VI_VI_LOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VI_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VI_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VI_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VI_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VI_PARAMS, BODY)
+
+#define VI_VV_SIMD_ULOOP(BODY) \
+  VI_CHECK_SSS(true) \
+  VI_SIMD_SEW_LOOP(type_usew_t, VV_SIMD_DECLS, VV_U_PARAMS, BODY)
+
+#define VI_VV_SIMD_LOOP(BODY) \
+  VI_CHECK_SSS(true) \
+  VI_SIMD_SEW_LOOP(type_sew_t, VV_SIMD_DECLS, VV_PARAMS, BODY)
+
+#define VI_VX_SIMD_ULOOP(BODY) \
+  VI_CHECK_SSS(false) \
+  VI_SIMD_SEW_LOOP(type_usew_t, VX_SIMD_DECLS, VX_U_PARAMS, BODY)
+
+#define VI_VX_SIMD_LOOP(BODY) \
+  VI_CHECK_SSS(false) \
+  VI_SIMD_SEW_LOOP(type_sew_t, VX_SIMD_DECLS, VX_PARAMS, BODY)
+
+#define VI_VI_SIMD_ULOOP(BODY) \
+  VI_CHECK_SSS(false) \
+  VI_SIMD_SEW_LOOP(type_usew_t, VI_U_SIMD_DECLS, VI_U_PARAMS, BODY)
+
+#define VI_VI_SIMD_LOOP(BODY) \
+  VI_CHECK_SSS(false) \
+  VI_SIMD_SEW_LOOP(type_sew_t, VI_SIMD_DECLS, VI_PARAMS, BODY)
 
 // signed unsigned operation loop (e.g. mulhsu)
 #define VI_VV_SU_LOOP(BODY) \
   VI_CHECK_SSS(true) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VV_SU_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VV_SU_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VV_SU_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VV_SU_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VV_SU_PARAMS, BODY)
 
 #define VI_VX_SU_LOOP(BODY) \
   VI_CHECK_SSS(false) \
-  VI_LOOP_BASE \
-  if (sew == e8) { \
-    VX_SU_PARAMS(e8); \
-    BODY; \
-  } else if (sew == e16) { \
-    VX_SU_PARAMS(e16); \
-    BODY; \
-  } else if (sew == e32) { \
-    VX_SU_PARAMS(e32); \
-    BODY; \
-  } else if (sew == e64) { \
-    VX_SU_PARAMS(e64); \
-    BODY; \
-  } \
-  VI_LOOP_END 
+  VI_SEW_LOOP(VX_SU_PARAMS, BODY)
 
 // narrow operation loop
 #define VI_VV_LOOP_NARROW(BODY) \
@@ -1153,49 +1270,179 @@ VI_VX_ULOOP({ \
   vd = res >> 1; \
 })
 
+//
+// vector: register gather
+//
+// vd[i] = vs2[index] for each active element, or 0 if index >= VLMAX. The
+// source is read as a flat register group, which vd may not overlap.
+#define VI_GATHER_SEW(x, INDEX) \
+  { \
+    typedef type_usew_t<x>::type elt_t; \
+    for (reg_t i = vstart; i < vl; ++i) { \
+      VI_LOOP_ELEMENT_SKIP(); \
+      const reg_t index = (INDEX); \
+      VI_GROUP_ELT(elt_t, rd, true) = \
+        index >= vlmax ? 0 : VI_GROUP_ELT_AT(elt_t, rs2, index, false); \
+    } \
+  }
+
+// With a scalar index every active element gets the same value.
+#define VI_GATHER_SPLAT_SEW(x, INDEX) \
+  { \
+    typedef type_usew_t<x>::type elt_t; \
+    const reg_t index = (INDEX); \
+    const elt_t val = \
+      index >= vlmax ? 0 : VI_GROUP_ELT_AT(elt_t, rs2, index, false); \
+    for (reg_t i = vstart; i < vl; ++i) { \
+      VI_LOOP_ELEMENT_SKIP(); \
+      VI_GROUP_ELT(elt_t, rd, true) = val; \
+    } \
+  }
+
+#define VI_GATHER_LOOP(SEW_LOOP, INDEX) \
+  VI_GENERAL_LOOP_VARS \
+  const reg_t vlmax = P.VU.vlmax; \
+  const reg_t vstart = P.VU.vstart->read(); \
+  if (sew == e8) { \
+    SEW_LOOP(e8, INDEX) \
+  } else if (sew == e16) { \
+    SEW_LOOP(e16, INDEX) \
+  } else if (sew == e32) { \
+    SEW_LOOP(e32, INDEX) \
+  } else if (sew == e64) { \
+    SEW_LOOP(e64, INDEX) \
+  } \
+  P.VU.vstart->write(0);
+
+#define VI_GATHER(INDEX) VI_GATHER_LOOP(VI_GATHER_SEW, INDEX)
+#define VI_GATHER_SPLAT(INDEX) VI_GATHER_LOOP(VI_GATHER_SPLAT_SEW, INDEX)
+
 //
 // vector: load/store helper 
 //
 #define VI_STRIP(inx) \
   reg_t vreg_inx = inx;
 
-#define VI_DUPLICATE_VREG(reg_num, idx_sew) \
-reg_t index[P.VU.vlmax]; \
- for (reg_t i = 0; i < P.VU.vlmax && P.VU.vl->read() != 0; ++i) { \
-  switch (idx_sew) { \
-    case e8: \
-      index[i] = P.VU.elt<uint8_t>(reg_num, i); \
-      break; \
-    case e16: \
-      index[i] = P.VU.elt<uint16_t>(reg_num, i); \
-      break; \
-    case e32: \
-      index[i] = P.VU.elt<uint32_t>(reg_num, i); \
-      break; \
-    case e64: \
-      index[i] = P.VU.elt<uint64_t>(reg_num, i); \
-      break; \
-  } \
-}
+// Indices of indexed accesses are read straight from the index register
+// group as each element is accessed. Where the destination may legally
+// overlap the index group, a write only clobbers indices already used.
+#define VI_INDEX_VARS \
+  const reg_t idx_num = insn.rs2(); \
+  char *idx_group = P.VU.elt_group<char>(idx_num);
+
+#define VI_INDEX(idx_sew, n) \
+  ((reg_t)VI_GROUP_ELT_AT(type_usew_t<idx_sew>::type, idx, n, false))
+
+// Vector memory instructions look up each page they touch once. The first
+// element on a page goes through the MMU, which takes any fault and refills
+// the TLB, and the rest of the page is accessed in host memory directly as
+// long as its TLB entry allows it (see mmu_t::host_page).
+#define VI_PAGE_VARS \
+  reg_t page_vpn = ~reg_t(0); \
+  char *page_host = NULL;
+
+#define VI_PAGE_HIT(addr, bytes) \
+  (((addr) >> PGSHIFT) == page_vpn && ((addr) & ((bytes) - 1)) == 0)
+
+#define VI_PAGE_REFILL(addr, type) \
+  page_host = MMU.host_page(addr, type); \
+  page_vpn = page_host ? (addr) >> PGSHIFT : ~reg_t(0);
+
+#define VI_PAGE_LOAD(elt_width, addr) \
+  ({ \
+    const reg_t page_addr = (addr); \
+    elt_width##_t page_val; \
+    if (VI_PAGE_HIT(page_addr, sizeof(elt_width##_t))) { \
+      page_val = MMU.from_target( \
+        *(target_endian<elt_width##_t>*)(page_host + (page_addr & (PGSIZE - 1)))); \
+    } else { \
+      page_val = MMU.load_##elt_width(page_addr); \
+      VI_PAGE_REFILL(page_addr, LOAD) \
+    } \
+    page_val; \
+  })
 
+#define VI_PAGE_STORE(elt_width, addr, val) \
+  do { \
+    const reg_t page_addr = (addr); \
+    const elt_width##_t page_val = (val); \
+    if (VI_PAGE_HIT(page_addr, sizeof(elt_width##_t))) { \
+      *(target_endian<elt_width##_t>*)(page_host + (page_addr & (PGSIZE - 1))) = \
+        MMU.to_target(page_val); \
+    } else { \
+      MMU.store_##elt_width(page_addr, page_val); \
+      VI_PAGE_REFILL(page_addr, STORE) \
+    } \
+  } while (0)
+
+// Unmasked accesses to consecutive elements copy every element from i up
+// to end that lies on the current page in one go. This needs memory and
+// the register file to share a little-endian layout.
+#define VI_PAGE_RUN_OK(contiguous) \
+  (VI_HOST_SIMD && insn.v_vm() == 1 && !MMU.is_target_big_endian() && (contiguous))
+
+#define VI_PAGE_RUN(elt_width, addr, end, COPY) \
+  if (page_run && VI_PAGE_HIT(addr, sizeof(elt_width##_t))) { \
+    const reg_t page_off = (addr) & (PGSIZE - 1); \
+    const reg_t n = std::min<reg_t>((end) - i, \
+      (PGSIZE - page_off) / sizeof(elt_width##_t)); \
+    COPY; \
+    i += n - 1; \
+    continue; \
+  }
+
+#define VI_PAGE_LOAD_RUN(elt_width, reg, addr, end) \
+  VI_PAGE_RUN(elt_width, addr, end, \
+    memcpy(P.VU.elt_group<elt_width##_t>(reg) + i, page_host + page_off, \
+           n * sizeof(elt_width##_t)))
+
+#define VI_PAGE_STORE_RUN(elt_width, reg, addr, end) \
+  VI_PAGE_RUN(elt_width, addr, end, \
+    memcpy(page_host + page_off, P.VU.elt_group<elt_width##_t>(reg) + i, \
+           n * sizeof(elt_width##_t)))
+
+// vstart is only written back if an element faults.
 #define VI_LD(stride, offset, elt_width, is_mask_ldst) \
   const reg_t nf = insn.v_nf() + 1; \
   const reg_t vl = is_mask_ldst ? ((P.VU.vl->read() + 7) / 8) : P.VU.vl->read(); \
   const reg_t baseAddr = RS1; \
   const reg_t vd = insn.rd(); \
   VI_CHECK_LOAD(elt_width, is_mask_ldst); \
-  for (reg_t i = 0; i < vl; ++i) { \
-    VI_ELEMENT_SKIP(i); \
-    VI_STRIP(i); \
-    P.VU.vstart->write(i); \
-    for (reg_t fn = 0; fn < nf; ++fn) { \
-      elt_width##_t val = MMU.load_##elt_width( \
-        baseAddr + (stride) + (offset) * sizeof(elt_width##_t)); \
-      P.VU.elt<elt_width##_t>(vd + fn * emul, vreg_inx, true) = val; \
+  auto elt_addr = [&](reg_t i, reg_t fn) { \
+    return baseAddr + (stride) + (offset) * sizeof(elt_width##_t); \
+  }; \
+  VI_PAGE_VARS \
+  const bool page_run = VI_PAGE_RUN_OK(nf == 1 && \
+    elt_addr(1, 0) - elt_addr(0, 0) == sizeof(elt_width##_t)); \
+  reg_t i = P.VU.vstart->read(); \
+  try { \
+    for (; i < vl; ++i) { \
+      VI_LOOP_ELEMENT_SKIP(); \
+      VI_STRIP(i); \
+      VI_PAGE_LOAD_RUN(elt_width, vd, elt_addr(i, 0), vl) \
+      for (reg_t fn = 0; fn < nf; ++fn) { \
+        elt_width##_t val = VI_PAGE_LOAD(elt_width, elt_addr(i, fn)); \
+        P.VU.elt<elt_width##_t>(vd + fn * emul, vreg_inx, true) = val; \
+      } \
     } \
+  } catch (...) { \
+    P.VU.vstart->write(i); \
+    throw; \
   } \
   P.VU.vstart->write(0);
 
+#define VI_LD_INDEX_SEW(elt_width, data_width) \
+  for (; i < vl; ++i) { \
+    VI_LOOP_ELEMENT_SKIP(); \
+    VI_STRIP(i); \
+    const reg_t addr = baseAddr + VI_INDEX(elt_width, i); \
+    for (reg_t fn = 0; fn < nf; ++fn) { \
+      data_width##_t val = VI_PAGE_LOAD(data_width, \
+        addr + fn * sizeof(data_width##_t)); \
+      P.VU.elt<data_width##_t>(vd + fn * flmul, vreg_inx, true) = val; \
+    } \
+  }
+
 #define VI_LD_INDEX(elt_width, is_seg) \
   const reg_t nf = insn.v_nf() + 1; \
   const reg_t vl = P.VU.vl->read(); \
@@ -1204,31 +1451,27 @@ reg_t index[P.VU.vlmax]; \
   if (!is_seg) \
     require(nf == 1); \
   VI_CHECK_LD_INDEX(elt_width); \
-  VI_DUPLICATE_VREG(insn.rs2(), elt_width); \
-  for (reg_t i = 0; i < vl; ++i) { \
-    VI_ELEMENT_SKIP(i); \
-    VI_STRIP(i); \
-    P.VU.vstart->write(i); \
-    for (reg_t fn = 0; fn < nf; ++fn) { \
-      switch (P.VU.vsew) { \
-        case e8: \
-          P.VU.elt<uint8_t>(vd + fn * flmul, vreg_inx, true) = \
-            MMU.load_uint8(baseAddr + index[i] + fn * 1); \
-          break; \
-        case e16: \
-          P.VU.elt<uint16_t>(vd + fn * flmul, vreg_inx, true) = \
-            MMU.load_uint16(baseAddr + index[i] + fn * 2); \
-          break; \
-        case e32: \
-          P.VU.elt<uint32_t>(vd + fn * flmul, vreg_inx, true) = \
-            MMU.load_uint32(baseAddr + index[i] + fn * 4); \
-          break; \
-        default: \
-          P.VU.elt<uint64_t>(vd + fn * flmul, vreg_inx, true) = \
-            MMU.load_uint64(baseAddr + index[i] + fn * 8); \
-          break; \
-      } \
+  VI_INDEX_VARS \
+  VI_PAGE_VARS \
+  reg_t i = P.VU.vstart->read(); \
+  try { \
+    switch (P.VU.vsew) { \
+      case e8: \
+        VI_LD_INDEX_SEW(elt_width, uint8) \
+        break; \
+      case e16: \
+        VI_LD_INDEX_SEW(elt_width, uint16) \
+        break; \
+      case e32: \
+        VI_LD_INDEX_SEW(elt_width, uint32) \
+        break; \
+      default: \
+        VI_LD_INDEX_SEW(elt_width, uint64) \
+        break; \
     } \
+  } catch (...) { \
+    P.VU.vstart->write(i); \
+    throw; \
   } \
   P.VU.vstart->write(0);
 
@@ -1238,18 +1481,40 @@ reg_t index[P.VU.vlmax]; \
   const reg_t baseAddr = RS1; \
   const reg_t vs3 = insn.rd(); \
   VI_CHECK_STORE(elt_width, is_mask_ldst); \
-  for (reg_t i = 0; i < vl; ++i) { \
-    VI_STRIP(i) \
-    VI_ELEMENT_SKIP(i); \
-    P.VU.vstart->write(i); \
-    for (reg_t fn = 0; fn < nf; ++fn) { \
-      elt_width##_t val = P.VU.elt<elt_width##_t>(vs3 + fn * emul, vreg_inx); \
-      MMU.store_##elt_width( \
-        baseAddr + (stride) + (offset) * sizeof(elt_width##_t), val); \
+  auto elt_addr = [&](reg_t i, reg_t fn) { \
+    return baseAddr + (stride) + (offset) * sizeof(elt_width##_t); \
+  }; \
+  VI_PAGE_VARS \
+  const bool page_run = VI_PAGE_RUN_OK(nf == 1 && \
+    elt_addr(1, 0) - elt_addr(0, 0) == sizeof(elt_width##_t)); \
+  reg_t i = P.VU.vstart->read(); \
+  try { \
+    for (; i < vl; ++i) { \
+      VI_STRIP(i) \
+      VI_LOOP_ELEMENT_SKIP(); \
+      VI_PAGE_STORE_RUN(elt_width, vs3, elt_addr(i, 0), vl) \
+      for (reg_t fn = 0; fn < nf; ++fn) { \
+        elt_width##_t val = P.VU.elt<elt_width##_t>(vs3 + fn * emul, vreg_inx); \
+        VI_PAGE_STORE(elt_width, elt_addr(i, fn), val); \
+      } \
     } \
+  } catch (...) { \
+    P.VU.vstart->write(i); \
+    throw; \
   } \
   P.VU.vstart->write(0);
 
+#define VI_ST_INDEX_SEW(elt_width, data_width) \
+  for (; i < vl; ++i) { \
+    VI_STRIP(i) \
+    VI_LOOP_ELEMENT_SKIP(); \
+    const reg_t addr = baseAddr + VI_INDEX(elt_width, i); \
+    for (reg_t fn = 0; fn < nf; ++fn) { \
+      data_width##_t val = P.VU.elt<data_width##_t>(vs3 + fn * flmul, vreg_inx); \
+      VI_PAGE_STORE(data_width, addr + fn * sizeof(data_width##_t), val); \
+    } \
+  }
+
 #define VI_ST_INDEX(elt_width, is_seg) \
   const reg_t nf = insn.v_nf() + 1; \
   const reg_t vl = P.VU.vl->read(); \
@@ -1258,31 +1523,27 @@ reg_t index[P.VU.vlmax]; \
   if (!is_seg) \
     require(nf == 1); \
   VI_CHECK_ST_INDEX(elt_width); \
-  VI_DUPLICATE_VREG(insn.rs2(), elt_width); \
-  for (reg_t i = 0; i < vl; ++i) { \
-    VI_STRIP(i) \
-    VI_ELEMENT_SKIP(i); \
-    P.VU.vstart->write(i); \
-    for (reg_t fn = 0; fn < nf; ++fn) { \
-      switch (P.VU.vsew) { \
+  VI_INDEX_VARS \
+  VI_PAGE_VARS \
+  reg_t i = P.VU.vstart->read(); \
+  try { \
+    switch (P.VU.vsew) { \
       case e8: \
-        MMU.store_uint8(baseAddr + index[i] + fn * 1, \
-          P.VU.elt<uint8_t>(vs3 + fn * flmul, vreg_inx)); \
+        VI_ST_INDEX_SEW(elt_width, uint8) \
         break; \
       case e16: \
-        MMU.store_uint16(baseAddr + index[i] + fn * 2, \
-          P.VU.elt<uint16_t>(vs3 + fn * flmul, vreg_inx)); \
+        VI_ST_INDEX_SEW(elt_width, uint16) \
         break; \
       case e32: \
-        MMU.store_uint32(baseAddr + index[i] + fn * 4, \
-          P.VU.elt<uint32_t>(vs3 + fn * flmul, vreg_inx)); \
+        VI_ST_INDEX_SEW(elt_width, uint32) \
         break; \
       default: \
-        MMU.store_uint64(baseAddr + index[i] + fn * 8, \
-          P.VU.elt<uint64_t>(vs3 + fn * flmul, vreg_inx)); \
+        VI_ST_INDEX_SEW(elt_width, uint64) \
         break; \
-      } \
     } \
+  } catch (...) { \
+    P.VU.vstart->write(i); \
+    throw; \
   } \
   P.VU.vstart->write(0);
 
@@ -1293,15 +1554,19 @@ reg_t index[P.VU.vlmax]; \
   const reg_t baseAddr = RS1; \
   const reg_t rd_num = insn.rd(); \
   VI_CHECK_LOAD(elt_width, false); \
+  VI_PAGE_VARS \
+  const bool page_run = VI_PAGE_RUN_OK(nf == 1); \
   bool early_stop = false; \
   for (reg_t i = p->VU.vstart->read(); i < vl; ++i) { \
     VI_STRIP(i); \
-    VI_ELEMENT_SKIP(i); \
+    VI_LOOP_ELEMENT_SKIP(); \
+    VI_PAGE_LOAD_RUN(elt_width, rd_num, \
+      baseAddr + i * sizeof(elt_width##_t), vl) \
     \
     for (reg_t fn = 0; fn < nf; ++fn) { \
       uint64_t val; \
       try { \
-        val = MMU.load_##elt_width( \
+        val = VI_PAGE_LOAD(elt_width, \
           baseAddr + (i * nf + fn) * sizeof(elt_width##_t)); \
       } catch (trap_t& t) { \
         if (i == 0) \
@@ -1329,26 +1594,19 @@ reg_t index[P.VU.vlmax]; \
   require_align(vd, len); \
   const reg_t elt_per_reg = P.VU.vlenb / sizeof(elt_width ## _t); \
   const reg_t size = len * elt_per_reg; \
-  if (P.VU.vstart->read() < size) { \
-    reg_t i = P.VU.vstart->read() / elt_per_reg; \
-    reg_t off = P.VU.vstart->read() % elt_per_reg; \
-    if (off) { \
-      for (reg_t pos = off; pos < elt_per_reg; ++pos) { \
-        auto val = MMU.load_## elt_width(baseAddr + \
-          P.VU.vstart->read() * sizeof(elt_width ## _t)); \
-        P.VU.elt<elt_width ## _t>(vd + i, pos, true) = val; \
-        P.VU.vstart->write(P.VU.vstart->read() + 1); \
-      } \
-      ++i; \
-    } \
-    for (; i < len; ++i) { \
-      for (reg_t pos = 0; pos < elt_per_reg; ++pos) { \
-        auto val = MMU.load_## elt_width(baseAddr + \
-          P.VU.vstart->read() * sizeof(elt_width ## _t)); \
-        P.VU.elt<elt_width ## _t>(vd + i, pos, true) = val; \
-        P.VU.vstart->write(P.VU.vstart->read() + 1); \
-      } \
+  VI_PAGE_VARS \
+  const bool page_run = VI_HOST_SIMD && !MMU.is_target_big_endian(); \
+  reg_t i = P.VU.vstart->read(); \
+  try { \
+    for (; i < size; ++i) { \
+      const reg_t addr = baseAddr + i * sizeof(elt_width ## _t); \
+      VI_PAGE_LOAD_RUN(elt_width, vd, addr, size) \
+      auto val = VI_PAGE_LOAD(elt_width, addr); \
+      P.VU.elt<elt_width ## _t>(vd, i, true) = val; \
     } \
+  } catch (...) { \
+    P.VU.vstart->write(i); \
+    throw; \
   } \
   P.VU.vstart->write(0);
 
@@ -1359,25 +1617,19 @@ reg_t index[P.VU.vlmax]; \
   const reg_t len = insn.v_nf() + 1; \
   require_align(vs3, len); \
   const reg_t size = len * P.VU.vlenb; \
-  \
-  if (P.VU.vstart->read() < size) { \
-    reg_t i = P.VU.vstart->read() / P.VU.vlenb; \
-    reg_t off = P.VU.vstart->read() % P.VU.vlenb; \
-    if (off) { \
-      for (reg_t pos = off; pos < P.VU.vlenb; ++pos) { \
-        auto val = P.VU.elt<uint8_t>(vs3 + i, pos); \
-        MMU.store_uint8(baseAddr + P.VU.vstart->read(), val); \
-        P.VU.vstart->write(P.VU.vstart->read() + 1); \
-      } \
-      i++; \
-    } \
-    for (; i < len; ++i) { \
-      for (reg_t pos = 0; pos < P.VU.vlenb; ++pos) { \
-        auto val = P.VU.elt<uint8_t>(vs3 + i, pos); \
-        MMU.store_uint8(baseAddr + P.VU.vstart->read(), val); \
-        P.VU.vstart->write(P.VU.vstart->read() + 1); \
-      } \
+  VI_PAGE_VARS \
+  const bool page_run = VI_HOST_SIMD && !MMU.is_target_big_endian(); \
+  reg_t i = P.VU.vstart->read(); \
+  try { \
+    for (; i < size; ++i) { \
+      const reg_t addr = baseAddr + i; \
+      VI_PAGE_STORE_RUN(uint8, vs3, addr, size) \
+      auto val = P.VU.elt<uint8_t>(vs3, i); \
+      VI_PAGE_STORE(uint8, addr, val); \
     } \
+  } catch (...) { \
+    P.VU.vstart->write(i); \
+    throw; \
   } \
   P.VU.vstart->write(0);
 
@@ -1405,7 +1657,7 @@ reg_t index[P.VU.vlmax]; \
       } \
     } \
   } \
-  VI_DUPLICATE_VREG(insn.rs2(), idx_type); \
+  VI_INDEX_VARS \
   const reg_t vl = P.VU.vl->read(); \
   const reg_t baseAddr = RS1; \
   const reg_t vd = insn.rd(); \
@@ -1416,14 +1668,14 @@ reg_t index[P.VU.vlmax]; \
     switch (P.VU.vsew) { \
     case e32: { \
       auto vs3 = P.VU.elt< type ## 32_t>(vd, vreg_inx); \
-      auto val = MMU.amo_uint32(baseAddr + index[i], [&](type ## 32_t lhs) { op }); \
+      auto val = MMU.amo_uint32(baseAddr + VI_INDEX(idx_type, i), [&](type ## 32_t lhs) { op }); \
       if (insn.v_wd()) \
         P.VU.elt< type ## 32_t>(vd, vreg_inx, true) = val; \
       } \
       break; \
     case e64: { \
       auto vs3 = P.VU.elt< type ## 64_t>(vd, vreg_inx); \
-      auto val = MMU.amo_uint64(baseAddr + index[i], [&](type ## 64_t lhs) { op }); \
+      auto val = MMU.amo_uint64(baseAddr + VI_INDEX(idx_type, i), [&](type ## 64_t lhs) { op }); \
       if (insn.v_wd()) \
         P.VU.elt< type ## 64_t>(vd, vreg_inx, true) = val; \
       } \
@@ -1597,6 +1849,10 @@ reg_t index[P.VU.vlmax]; \
 #define VI_VFP_VV_LOOP(BODY16, BODY32, BODY64) \
   VI_CHECK_SSS(true); \
   VI_VFP_LOOP_BASE \
+  VI_VFP_VV_ELEMENT(BODY16, BODY32, BODY64) \
+  VI_VFP_LOOP_END
+
+#define VI_VFP_VV_ELEMENT(BODY16, BODY32, BODY64) \
   switch (P.VU.vsew) { \
     case e16: { \
       VFP_VV_PARAMS(16); \
@@ -1620,8 +1876,7 @@ reg_t index[P.VU.vlmax]; \
       require(0); \
       break; \
   }; \
-  DEBUG_RVV_FP_VV; \
-  VI_VFP_LOOP_END
+  DEBUG_RVV_FP_VV;
 
 #define VI_VFP_V_LOOP(BODY16, BODY32, BODY64) \
   VI_CHECK_SSS(false); \
@@ -1652,6 +1907,47 @@ reg_t index[P.VU.vlmax]; \
 #define VI_VFP_VV_LOOP_REDUCTION(BODY16, BODY32, BODY64) \
   VI_CHECK_REDUCTION(false) \
   VI_VFP_COMMON \
+  VI_VFP_LOOP_REDUCTION_SEW(BODY16, BODY32, BODY64)
+
+// Sums accumulate on the host in element order, and fall back to
+// softfloat if that ends in a NaN or raises more than inexact. Like the
+// element loops below, this needs HOST_FP_SUPPORTED from host_fp.h.
+#define VI_VFP_HOST_REDUCTION(elt_type, width) \
+  if (HOST_FP_SUPPORTED && p->host_fp_enabled() && \
+      STATE.frm->read() == softfloat_round_near_even && vl > 0) { \
+    elt_type acc = vfp_host(P.VU.elt<float##width##_t>(rs1_num, 0)); \
+    feclearexcept(FE_ALL_EXCEPT); \
+    for (reg_t i = P.VU.vstart->read(); i < vl; ++i) { \
+      VI_LOOP_ELEMENT_SKIP(); \
+      acc += vfp_host(P.VU.elt<float##width##_t>(rs2_num, i)); \
+    } \
+    VI_VFP_HOST_FENCE(acc); \
+    const int host_flags = fetestexcept(FE_ALL_EXCEPT); \
+    if (!(host_flags & ~FE_INEXACT) && acc == acc) { \
+      if (host_flags & FE_INEXACT) \
+        softfloat_exceptionFlags |= softfloat_flag_inexact; \
+      set_fp_exceptions; \
+      P.VU.elt<float##width##_t>(rd_num, 0, true) = vfp_soft(acc); \
+      host_done = true; \
+    } \
+  }
+
+#define VI_VFP_VV_HOST_LOOP_REDUCTION_SUM(BODY16, BODY32, BODY64) \
+  VI_CHECK_REDUCTION(false) \
+  VI_VFP_COMMON \
+  bool host_done = false; \
+  if (P.VU.vsew == e32) { \
+    VI_VFP_HOST_REDUCTION(float, 32) \
+  } else if (P.VU.vsew == e64) { \
+    VI_VFP_HOST_REDUCTION(double, 64) \
+  } \
+  if (host_done) { \
+    P.VU.vstart->write(0); \
+  } else { \
+    VI_VFP_LOOP_REDUCTION_SEW(BODY16, BODY32, BODY64) \
+  }
+
+#define VI_VFP_LOOP_REDUCTION_SEW(BODY16, BODY32, BODY64) \
   switch (P.VU.vsew) { \
     case e16: { \
       VI_VFP_LOOP_REDUCTION_BASE(16) \
@@ -1716,6 +2012,10 @@ reg_t index[P.VU.vlmax]; \
 #define VI_VFP_VF_LOOP(BODY16, BODY32, BODY64) \
   VI_CHECK_SSS(false); \
   VI_VFP_LOOP_BASE \
+  VI_VFP_VF_ELEMENT(BODY16, BODY32, BODY64) \
+  VI_VFP_LOOP_END
+
+#define VI_VFP_VF_ELEMENT(BODY16, BODY32, BODY64) \
   switch (P.VU.vsew) { \
     case e16: { \
       VFP_VF_PARAMS(16); \
@@ -1739,8 +2039,152 @@ reg_t index[P.VU.vlmax]; \
       require(0); \
       break; \
   }; \
-  DEBUG_RVV_FP_VF; \
-  VI_VFP_LOOP_END
+  DEBUG_RVV_FP_VF;
+
+// With --host-fp and round-to-nearest-even, unmasked float32 and float64
+// elements are computed with host FP, VI_SIMD_BYTES at a time. Host IEEE
+// arithmetic agrees with softfloat, results and flags alike, unless a NaN
+// comes out or an exception other than inexact is raised. The host flags
+// are tested once for the whole group; if either happened, vd is left alone
+// and the element loop that follows redoes the group with softfloat.
+static inline float vfp_host(float32_t f) { float x; memcpy(&x, &f.v, sizeof(x)); return x; }
+static inline double vfp_host(float64_t f) { double x; memcpy(&x, &f.v, sizeof(x)); return x; }
+// f[rs1] as a host scalar of the same type as the second argument.
+template<class F> static inline float vfp_host_freg(F f, float) { return vfp_host(f32(f)); }
+template<class F> static inline double vfp_host_freg(F f, double) { return vfp_host(f64(f)); }
+static inline float32_t vfp_soft(float x) { float32_t f; memcpy(&f.v, &x, sizeof(x)); return f; }
+static inline float64_t vfp_soft(double x) { float64_t f; memcpy(&f.v, &x, sizeof(x)); return f; }
+
+// Lane l of a host SIMD operand, or a scalar operand itself.
+static inline float vfp_lane(float x, size_t) { return x; }
+static inline double vfp_lane(double x, size_t) { return x; }
+template<class V>
+static inline auto vfp_lane(const V& v, size_t l) -> decltype(+v[0]) { return v[l]; }
+
+// a * b + c with a single rounding, lane by lane. Where the host has FMA in
+// its base ISA, the compiler turns std::fma into that instruction; x86-64
+// does not, so there the FMA3 instructions are used if the CPU has them.
+template<class V>
+static inline V vfp_host_fma_lanes(V a, V b, V c)
+{
+  for (size_t l = 0; l < sizeof(V) / sizeof(a[0]); ++l)
+    a[l] = std::fma(a[l], b[l], c[l]);
+  return a;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+typedef float vfp_f32x4_t __attribute__((vector_size(16)));
+typedef double vfp_f64x2_t __attribute__((vector_size(16)));
+__attribute__((target("fma")))
+static inline vfp_f32x4_t vfp_host_fma3(vfp_f32x4_t a, vfp_f32x4_t b, vfp_f32x4_t c)
+{
+  return (vfp_f32x4_t)__builtin_ia32_vfmaddps(a, b, c);
+}
+__attribute__((target("fma")))
+static inline vfp_f64x2_t vfp_host_fma3(vfp_f64x2_t a, vfp_f64x2_t b, vfp_f64x2_t c)
+{
+  return (vfp_f64x2_t)__builtin_ia32_vfmaddpd(a, b, c);
+}
+template<class V>
+static inline V vfp_host_fma(V a, V b, V c)
+{
+  return __builtin_cpu_supports("fma") ? vfp_host_fma3(a, b, c) : vfp_host_fma_lanes(a, b, c);
+}
+#else
+template<class V>
+static inline V vfp_host_fma(V a, V b, V c) { return vfp_host_fma_lanes(a, b, c); }
+#endif
+
+// Keeps the compiler from moving host FP arithmetic past the flag test.
+#define VI_VFP_HOST_FENCE(x) asm volatile("" : "+m"(x) : : "memory")
+
+// A host FMA operand as a whole vector, broadcasting a scalar.
+#define VI_VFP_HOST_VEC(x) \
+  ({ \
+    simd_vec_t host_vec; \
+    for (reg_t l = 0; l < lanes; ++l) \
+      host_vec[l] = vfp_lane(x, l); \
+    host_vec; \
+  })
+
+#define VI_VFP_HOST_FMA(a, b, c) \
+  vfp_host_fma(VI_VFP_HOST_VEC(a), VI_VFP_HOST_VEC(b), VI_VFP_HOST_VEC(c))
+
+#define VFP_VF_SIMD_DECLS \
+  const simd_elt_t rs1 = vfp_host_freg(READ_FREG(rs1_num), simd_elt_t()); \
+  VI_SIMD_LOAD(vs2, rs2)
+
+// The largest register group, LMUL=8 at VLEN=4096, in bytes.
+#define VI_VFP_HOST_MAX_BYTES (8 * 4096 / 8)
+
+// Hosts whose FP evaluation is not IEEE-conformant (HOST_FP_SUPPORTED, from
+// host_fp.h, which the instruction files include) always take softfloat.
+#if VI_HOST_SIMD
+#define VI_VFP_HOST_ELEMENT_LOOP(elt_type, DECLS, HOST_BODY) \
+  if (HOST_FP_SUPPORTED && p->host_fp_enabled() && insn.v_vm() == 1 && \
+      STATE.frm->read() == softfloat_round_near_even && \
+      vstart + VI_SIMD_BYTES / sizeof(elt_type) <= vl) { \
+    typedef elt_type simd_elt_t; \
+    typedef simd_elt_t simd_vec_t __attribute__((vector_size(VI_SIMD_BYTES))); \
+    const reg_t lanes = VI_SIMD_BYTES / sizeof(simd_elt_t); \
+    const reg_t host_end = vstart + (vl - vstart) / lanes * lanes; \
+    alignas(VI_SIMD_BYTES) char host_vd[VI_VFP_HOST_MAX_BYTES]; \
+    decltype(simd_vec_t() != simd_vec_t()) host_nan = {}; \
+    feclearexcept(FE_ALL_EXCEPT); \
+    for (reg_t i = vstart; i < host_end; i += lanes) { \
+      VI_SIMD_LOAD(vd, rd) \
+      DECLS \
+      HOST_BODY; \
+      host_nan |= vd != vd; \
+      memcpy(host_vd + (i - vstart) * sizeof(simd_elt_t), &vd, sizeof(vd)); \
+    } \
+    VI_VFP_HOST_FENCE(host_vd); \
+    const int host_flags = fetestexcept(FE_ALL_EXCEPT); \
+    bool any_nan = false; \
+    for (reg_t l = 0; l < lanes; ++l) \
+      any_nan |= host_nan[l] != 0; \
+    if (likely(!(host_flags & ~FE_INEXACT) && !any_nan)) { \
+      memcpy(rd_group + vstart * sizeof(simd_elt_t), host_vd, \
+             (host_end - vstart) * sizeof(simd_elt_t)); \
+      vstart = host_end; \
+      if (host_flags & FE_INEXACT) { \
+        softfloat_exceptionFlags |= softfloat_flag_inexact; \
+        set_fp_exceptions; \
+      } \
+    } \
+  }
+#else
+#define VI_VFP_HOST_ELEMENT_LOOP(elt_type, DECLS, HOST_BODY)
+#endif
+
+#define VI_VFP_HOST_LOOP(DECLS, HOST_BODY) \
+  VI_GROUP_VARS \
+  reg_t vstart = P.VU.vstart->read(); \
+  if (P.VU.vsew == e32) { \
+    VI_VFP_HOST_ELEMENT_LOOP(float, DECLS, HOST_BODY) \
+  } else if (P.VU.vsew == e64) { \
+    VI_VFP_HOST_ELEMENT_LOOP(double, DECLS, HOST_BODY) \
+  }
+
+#define VI_VFP_VV_HOST_LOOP(HOST_BODY, BODY16, BODY32, BODY64) \
+  VI_CHECK_SSS(true); \
+  VI_VFP_COMMON \
+  VI_VFP_HOST_LOOP(VV_SIMD_DECLS, HOST_BODY) \
+  for (reg_t i = vstart; i < vl; ++i) { \
+    VI_LOOP_ELEMENT_SKIP(); \
+    VI_VFP_VV_ELEMENT(BODY16, BODY32, BODY64) \
+  } \
+  P.VU.vstart->write(0);
+
+#define VI_VFP_VF_HOST_LOOP(HOST_BODY, BODY16, BODY32, BODY64) \
+  VI_CHECK_SSS(false); \
+  VI_VFP_COMMON \
+  VI_VFP_HOST_LOOP(VFP_VF_SIMD_DECLS, HOST_BODY) \
+  for (reg_t i = vstart; i < vl; ++i) { \
+    VI_LOOP_ELEMENT_SKIP(); \
+    VI_VFP_VF_ELEMENT(BODY16, BODY32, BODY64) \
+  } \
+  P.VU.vstart->write(0);
 
 #define VI_VFP_VV_LOOP_CMP(BODY16, BODY32, BODY64) \
   VI_CHECK_MSS(true); \
@@ -5,11 +5,16 @@
 #include "mmu.h"
 #include "remote_bitbang.h"
 #include "cachesim.h"
+#include "memtrace_file.h"
+#include "timing_model.h"
 #include "extension.h"
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <fesvr/option_parser.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <vector>
 #include <string>
 #include <memory>
@@ -25,6 +30,7 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  -m<n>                 Provide <n> MiB of target memory [default 2048]\n");
   fprintf(stderr, "  -m<a:m,b:n,...>       Provide memory regions of size m and n bytes\n");
   fprintf(stderr, "                          at base addresses a and b (with 4 KiB alignment)\n");
+  fprintf(stderr, "  --hugepages           Back target memory with host huge pages if available\n");
   fprintf(stderr, "  -d                    Interactive debug mode\n");
   fprintf(stderr, "  -g                    Track histogram of PCs\n");
   fprintf(stderr, "  -l                    Generate a log of execution\n");
@@ -40,9 +46,16 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  --varch=<name>        RISC-V Vector uArch string [default %s]\n", DEFAULT_VARCH);
   fprintf(stderr, "  --pc=<address>        Override ELF entry point\n");
   fprintf(stderr, "  --hartids=<a,b,...>   Explicitly specify hartids, default is 0,1,...\n");
-  fprintf(stderr, "  --ic=<S>:<W>:<B>      Instantiate a cache model with S sets,\n");
-  fprintf(stderr, "  --dc=<S>:<W>:<B>        W ways, and B-byte blocks (with S and\n");
-  fprintf(stderr, "  --l2=<S>:<W>:<B>        B both powers of 2).\n");
+  fprintf(stderr, "  --ic=<S>:<W>:<B>[:<P>] Instantiate a cache model with S sets,\n");
+  fprintf(stderr, "  --dc=<S>:<W>:<B>[:<P>]   W ways, and B-byte blocks (with S and\n");
+  fprintf(stderr, "  --l2=<S>:<W>:<B>[:<P>]   B both powers of 2), replacing lines by\n");
+  fprintf(stderr, "                          policy P: random (default), lru, plru,\n");
+  fprintf(stderr, "                          srrip, or fifo. Each hart gets private\n");
+  fprintf(stderr, "                          L1 caches; with more than one hart, their\n");
+  fprintf(stderr, "                          D$s are kept coherent by a directory\n");
+  fprintf(stderr, "                          (for at most 64 harts).\n");
+  fprintf(stderr, "  --l2-harts=<n>        Give each group of <n> harts its own L2 [default: all harts share one]\n");
+  fprintf(stderr, "  --l3=<S>:<W>:<B>[:<P>] Add a shared L3 cache model behind the L2s\n");
   fprintf(stderr, "  --device=<P,B,A>      Attach MMIO plugin device from an --extlib library\n");
   fprintf(stderr, "                          P -- Name of the MMIO plugin\n");
   fprintf(stderr, "                          B -- Base memory address of the device\n");
@@ -50,6 +63,17 @@ static void help(int exit_code = 1)
   fprintf(stderr, "                          This flag can be used multiple times.\n");
   fprintf(stderr, "                          The extlib flag for the library must come first.\n");
   fprintf(stderr, "  --log-cache-miss      Generate a log of cache miss\n");
+  fprintf(stderr, "  --timing=<config>     Drive mcycle and the clint from an in-order pipeline timing model,\n");
+  fprintf(stderr, "                          configured by \"default\" or key=value pairs such as\n");
+  fprintf(stderr, "                          mul=3,div=20,mispredict=3,l1-miss=10,l2-miss=100\n");
+  fprintf(stderr, "  --host-fp             Compute F and D arithmetic, scalar and vector, on the host\n");
+  fprintf(stderr, "                          FPU when it matches softfloat bit for bit\n");
+  fprintf(stderr, "  --mem-trace=<path>    Write a binary trace of loads and stores to <path>\n");
+  fprintf(stderr, "  --mem-trace-fetches   Include instruction fetches in the memory trace\n");
+  fprintf(stderr, "  --mem-trace-insns=<start>:<end>\n");
+  fprintf(stderr, "                        Only trace while start <= instret < end\n");
+  fprintf(stderr, "  --mem-trace-pc=<lo>:<hi>\n");
+  fprintf(stderr, "                        Only trace instructions with lo <= pc < hi\n");
   fprintf(stderr, "  --extension=<name>    Specify RoCC Extension\n");
   fprintf(stderr, "                          This flag can be used multiple times.\n");
   fprintf(stderr, "  --extlib=<name>       Shared library to load\n");
@@ -62,6 +86,10 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  --initrd=<path>       Load kernel initrd into memory\n");
   fprintf(stderr, "  --bootargs=<args>     Provide custom bootargs for kernel [default: console=hvc0 earlycon=sbi]\n");
   fprintf(stderr, "  --real-time-clint     Increment clint time at real-time rate\n");
+  fprintf(stderr, "  --real-time-clint-scale=<n>\n");
+  fprintf(stderr, "                        Run the real-time clint <n> times slower than wall-clock time\n");
+  fprintf(stderr, "  --linux-user          Run an RV64 Linux executable in U-mode, servicing its\n");
+  fprintf(stderr, "                        system calls on the host; each thread needs a hart (-p)\n");
   fprintf(stderr, "  --dm-progsize=<words> Progsize for the debug module [default 2]\n");
   fprintf(stderr, "  --dm-sba=<bits>       Debug system bus access supports up to "
       "<bits> wide accesses [default 0]\n");
@@ -100,12 +128,29 @@ static std::ifstream::pos_type get_file_size(const char *filename)
 static void read_file_bytes(const char *filename,size_t fileoff,
                             mem_t* mem, size_t memoff, size_t read_sz)
 {
-  std::ifstream in(filename, std::ios::in | std::ios::binary);
-  in.seekg(fileoff, std::ios::beg);
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "couldn't open %s\n", filename);
+    exit(-1);
+  }
+
+  // Map whole pages of the file straight into target memory, and copy the
+  // rest from a read-only mapping rather than through a staging buffer.
+  size_t mapped = mem->map_file(memoff, fd, fileoff, read_sz);
+  if (mapped < read_sz) {
+    size_t map_off = fileoff & ~(size_t)(PGSIZE - 1);
+    size_t map_len = fileoff - map_off + read_sz;
+    void* buf = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, map_off);
+    if (buf == MAP_FAILED) {
+      fprintf(stderr, "couldn't map %s\n", filename);
+      exit(-1);
+    }
+    const uint8_t* src = (const uint8_t*)buf + (fileoff - map_off);
+    mem->store(memoff + mapped, read_sz - mapped, src + mapped);
+    munmap(buf, map_len);
+  }
 
-  std::vector<char> read_buf(read_sz, 0);
-  in.read(&read_buf[0], read_sz);
-  mem->store(memoff, read_sz, (uint8_t*)&read_buf[0]);
+  close(fd);
 }
 
 bool sort_mem_region(const mem_cfg_t &a, const mem_cfg_t &b)
@@ -194,16 +239,29 @@ static std::vector<mem_cfg_t> parse_mem_layout(const char* arg)
   return res;
 }
 
-static std::vector<std::pair<reg_t, mem_t*>> make_mems(const std::vector<mem_cfg_t> &layout)
+static std::vector<std::pair<reg_t, mem_t*>> make_mems(const std::vector<mem_cfg_t> &layout,
+                                                       bool hugepages)
 {
   std::vector<std::pair<reg_t, mem_t*>> mems;
   mems.reserve(layout.size());
   for (const auto &cfg : layout) {
-    mems.push_back(std::make_pair(cfg.base, new mem_t(cfg.size)));
+    mems.push_back(std::make_pair(cfg.base, new mem_t(cfg.size, hugepages)));
   }
   return mems;
 }
 
+static std::pair<uint64_t, uint64_t> parse_range(const char* arg)
+{
+  char* p;
+  auto lo = strtoull(arg, &p, 0);
+  if (*p != ':')
+    help();
+  auto hi = strtoull(p + 1, &p, 0);
+  if (*p || hi < lo)
+    help();
+  return std::make_pair(lo, hi);
+}
+
 static unsigned long atoul_safe(const char* s)
 {
   char* e;
@@ -245,12 +303,27 @@ int main(int argc, char** argv)
   bool socket = false;  // command line option -s
   bool dump_dts = false;
   bool dtb_enabled = true;
+  bool hugepages = false;
   const char* kernel = NULL;
   reg_t kernel_offset, kernel_size;
   std::vector<std::pair<reg_t, abstract_device_t*>> plugin_devices;
-  std::unique_ptr<icache_sim_t> ic;
-  std::unique_ptr<dcache_sim_t> dc;
-  std::unique_ptr<cache_sim_t> l2;
+  const char* ic_config = NULL;
+  const char* dc_config = NULL;
+  const char* l2_config = NULL;
+  const char* l3_config = NULL;
+  const char* timing_config = NULL;
+  bool host_fp = false;
+  size_t l2_harts = 0;
+  std::unique_ptr<cache_sim_t> l3;
+  std::vector<std::unique_ptr<cache_sim_t>> l2s;
+  std::vector<std::unique_ptr<icache_sim_t>> ics;
+  std::vector<std::unique_ptr<dcache_sim_t>> dcs;
+  std::unique_ptr<coherence_directory_t> directory;
+  const char* mem_trace_path = NULL;
+  bool mem_trace_fetches = false;
+  std::pair<uint64_t, uint64_t> mem_trace_insns(0, UINT64_MAX);
+  std::pair<uint64_t, uint64_t> mem_trace_pc(0, UINT64_MAX);
+  std::unique_ptr<memtrace_file_t> mem_trace;
   bool log_cache = false;
   bool log_commits = false;
   const char *log_path = nullptr;
@@ -336,6 +409,7 @@ int main(int argc, char** argv)
 #endif
   parser.option('p', 0, 1, [&](const char* s){nprocs = atoul_nonzero_safe(s);});
   parser.option('m', 0, 1, [&](const char* s){cfg.mem_layout = parse_mem_layout(s);});
+  parser.option(0, "hugepages", 0, [&](const char* s){hugepages = true;});
   // I wanted to use --halted, but for some reason that doesn't work.
   parser.option('H', 0, 0, [&](const char* s){halted = true;});
   parser.option(0, "rbb-port", 1, [&](const char* s){use_rbb = true; rbb_port = atoul_safe(s);});
@@ -344,10 +418,18 @@ int main(int argc, char** argv)
     cfg.hartids = parse_hartids(s);
     cfg.explicit_hartids = true;
   });
-  parser.option(0, "ic", 1, [&](const char* s){ic.reset(new icache_sim_t(s));});
-  parser.option(0, "dc", 1, [&](const char* s){dc.reset(new dcache_sim_t(s));});
-  parser.option(0, "l2", 1, [&](const char* s){l2.reset(cache_sim_t::construct(s, "L2$"));});
+  parser.option(0, "ic", 1, [&](const char* s){ic_config = s;});
+  parser.option(0, "dc", 1, [&](const char* s){dc_config = s;});
+  parser.option(0, "l2", 1, [&](const char* s){l2_config = s;});
+  parser.option(0, "l2-harts", 1, [&](const char* s){l2_harts = atoul_nonzero_safe(s);});
+  parser.option(0, "l3", 1, [&](const char* s){l3_config = s;});
   parser.option(0, "log-cache-miss", 0, [&](const char* s){log_cache = true;});
+  parser.option(0, "timing", 1, [&](const char* s){timing_config = s;});
+  parser.option(0, "host-fp", 0, [&](const char* s){host_fp = true;});
+  parser.option(0, "mem-trace", 1, [&](const char* s){mem_trace_path = s;});
+  parser.option(0, "mem-trace-fetches", 0, [&](const char* s){mem_trace_fetches = true;});
+  parser.option(0, "mem-trace-insns", 1, [&](const char* s){mem_trace_insns = parse_range(s);});
+  parser.option(0, "mem-trace-pc", 1, [&](const char* s){mem_trace_pc = parse_range(s);});
   parser.option(0, "isa", 1, [&](const char* s){cfg.isa = s;});
   parser.option(0, "priv", 1, [&](const char* s){cfg.priv = s;});
   parser.option(0, "varch", 1, [&](const char* s){cfg.varch = s;});
@@ -360,6 +442,11 @@ int main(int argc, char** argv)
   parser.option(0, "initrd", 1, [&](const char* s){initrd = s;});
   parser.option(0, "bootargs", 1, [&](const char* s){cfg.bootargs = s;});
   parser.option(0, "real-time-clint", 0, [&](const char *s){cfg.real_time_clint = true;});
+  parser.option(0, "real-time-clint-scale", 1, [&](const char *s){
+    cfg.real_time_clint = true;
+    cfg.real_time_clint_scale = atoul_nonzero_safe(s);
+  });
+  parser.option(0, "linux-user", 0, [&](const char *s){cfg.linux_user = true;});
   parser.option(0, "extlib", 1, [&](const char *s){
     void *lib = dlopen(s, RTLD_NOW | RTLD_GLOBAL);
     if (lib == NULL) {
@@ -410,7 +497,8 @@ int main(int argc, char** argv)
   if (!*argv1)
     help();
 
-  std::vector<std::pair<reg_t, mem_t*>> mems = make_mems(cfg.mem_layout());
+  std::vector<std::pair<reg_t, mem_t*>> mems = make_mems(cfg.mem_layout(), hugepages);
+  std::vector<std::pair<reg_t, size_t>> preloaded;
 
   if (kernel && check_file_exists(kernel)) {
     const char *isa = cfg.isa();
@@ -422,6 +510,7 @@ int main(int argc, char** argv)
     for (auto& m : mems) {
       if (kernel_size && (kernel_offset + kernel_size) < m.second->size()) {
          read_file_bytes(kernel, 0, m.second, kernel_offset, kernel_size);
+         preloaded.push_back(std::make_pair(m.first + kernel_offset, kernel_size));
          break;
       }
     }
@@ -435,6 +524,7 @@ int main(int argc, char** argv)
          reg_t initrd_start = initrd_end - initrd_size;
          cfg.initrd_bounds = std::make_pair(initrd_start, initrd_end);
          read_file_bytes(initrd, 0, m.second, initrd_start - m.first, initrd_size);
+         preloaded.push_back(std::make_pair(initrd_start, initrd_size));
          break;
       }
     }
@@ -489,6 +579,8 @@ int main(int argc, char** argv)
       io_service_ptr, acceptor_ptr,
 #endif
       cmd_file);
+  for (auto& p : preloaded)
+    s.mark_preloaded(p.first, p.second);
   std::unique_ptr<remote_bitbang_t> remote_bitbang((remote_bitbang_t *) NULL);
   std::unique_ptr<jtag_dtm_t> jtag_dtm(
       new jtag_dtm_t(&s.debug_module, dmi_rti));
@@ -502,14 +594,66 @@ int main(int argc, char** argv)
     return 0;
   }
 
-  if (ic && l2) ic->set_miss_handler(&*l2);
-  if (dc && l2) dc->set_miss_handler(&*l2);
-  if (ic) ic->set_log(log_cache);
-  if (dc) dc->set_log(log_cache);
+  // Build the cache hierarchy: private L1s per hart, an L2 per group of
+  // l2_harts harts, and an optional shared L3.
+  if (!l2_harts || l2_harts > cfg.nprocs())
+    l2_harts = cfg.nprocs();
+  if (l3_config) {
+    l3.reset(cache_sim_t::construct(l3_config, "L3$"));
+    l3->set_log(log_cache);
+  }
+  for (size_t i = 0; l2_config && i < cfg.nprocs(); i += l2_harts) {
+    std::string name = l2_harts == cfg.nprocs() ? "L2$" : "L2$" + std::to_string(i / l2_harts);
+    l2s.emplace_back(cache_sim_t::construct(l2_config, name.c_str()));
+    l2s.back()->set_miss_handler(l3.get());
+    l2s.back()->set_log(log_cache);
+  }
+  if (dc_config && cfg.nprocs() > 1) {
+    if (cfg.nprocs() > coherence_directory_t::MAX_CACHES) {
+      fprintf(stderr, "Coherent D$s support at most %zu harts\n", coherence_directory_t::MAX_CACHES);
+      exit(1);
+    }
+    directory.reset(new coherence_directory_t());
+  }
+  if (mem_trace_path) {
+    mem_trace.reset(new memtrace_file_t(mem_trace_path, mem_trace_fetches));
+    mem_trace->set_instret_window(mem_trace_insns.first, mem_trace_insns.second);
+    mem_trace->set_pc_range(mem_trace_pc.first, mem_trace_pc.second);
+  }
+
   for (size_t i = 0; i < cfg.nprocs(); i++)
   {
-    if (ic) s.get_core(i)->get_mmu()->register_memtracer(&*ic);
-    if (dc) s.get_core(i)->get_mmu()->register_memtracer(&*dc);
+    std::string prefix = cfg.nprocs() > 1 ? "C" + std::to_string(i) + " " : "";
+    cache_sim_t* next_level = l2s.empty() ? l3.get() : l2s[i / l2_harts].get();
+    if (ic_config) {
+      ics.emplace_back(new icache_sim_t(ic_config, (prefix + "I$").c_str()));
+      ics.back()->set_miss_handler(next_level);
+      ics.back()->set_log(log_cache);
+      s.get_core(i)->get_mmu()->register_memtracer(ics.back().get());
+    }
+    if (dc_config) {
+      dcs.emplace_back(new dcache_sim_t(dc_config, (prefix + "D$").c_str()));
+      dcs.back()->set_miss_handler(next_level);
+      dcs.back()->set_log(log_cache);
+      if (directory)
+        dcs.back()->set_directory(directory.get());
+      s.get_core(i)->get_mmu()->register_memtracer(dcs.back().get());
+    }
+    if (timing_config) {
+      timing_model_t* timing = new timing_model_t(timing_config, (prefix + "Timing").c_str());
+      if (ic_config)
+        timing->add_cache(ics.back()->get_cache(), 1);
+      if (dc_config)
+        timing->add_cache(dcs.back()->get_cache(), 1);
+      if (!l2s.empty())
+        timing->add_cache(l2s[i / l2_harts].get(), 2);
+      if (l3)
+        timing->add_cache(l3.get(), 3);
+      s.get_core(i)->set_timing_model(timing);
+    }
+    s.get_core(i)->set_host_fp(host_fp);
+    if (mem_trace)
+      s.get_core(i)->get_mmu()->register_memtracer(mem_trace.get());
     for (auto e : extensions)
       s.get_core(i)->register_extension(e());
     s.get_core(i)->get_mmu()->set_cache_blocksz(blocksz);